@@ -0,0 +1,311 @@
+#ifndef ADDRESS_BOOK_HPP
+#define ADDRESS_BOOK_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <util/crc16.h>
+
+// Bluetooth targets in the EEPROM, one record per target number.
+//
+// The book starts with a header of the magic and the version of the record
+// format. Every record carries the format version, 0xff for an empty slot,
+// and a CRC-CCITT of its other bytes, so that a corrupt record is detected
+// rather than connected to. The addresses, protocols and the two lowest
+// flags are kept in a RAM index of seven bytes per slot loaded once by
+// init(); the names stay in the EEPROM and are found through a table of
+// their hashes sorted for a binary search.
+//
+// A book in the raw layout of the older firmware is converted in the
+// background: init() indexes it as it will be converted and migrate_step()
+// writes the records one by one, the header last.
+//
+// Eeprom is expected to behave like eeprom_writer.
+template <typename Eeprom, uint8_t Size = 64>
+class address_book
+{
+public:
+	static const uint8_t size = Size;
+	static const uint8_t name_length = 8;
+	static const uint8_t no_slot = 0xff;
+	static const uint8_t version = 1;
+
+	// Record flags
+	static const uint8_t flag_migrated = (1<<0);
+
+	enum status_t { empty, valid, corrupt };
+
+	struct record
+	{
+		uint8_t version;
+		uint8_t mac[6];
+		char name[name_length]; // zero-padded, not terminated when full
+		uint8_t protocol;       // preferred protocol, 0 if none
+		uint8_t flags;
+		uint16_t crc;
+	};
+
+	static const uint16_t header_size = 3;
+	static const uint16_t eeprom_size = header_size + Size * sizeof(record);
+
+	address_book(Eeprom & eeprom, uint16_t offset)
+		: m_eeprom(eeprom), m_offset(offset), m_named(0), m_legacy_offset(0), m_migrated(Size)
+	{
+	}
+
+	// Loads the index. A missing book is indexed from the raw layout of
+	// six-byte addresses at legacy_offset and converted by migrate_step().
+	void init(uint16_t legacy_offset)
+	{
+		uint8_t header[header_size];
+		m_eeprom.load(m_offset, header, header_size);
+		bool const migrate = header[0] != magic0 || header[1] != magic1 || header[2] != version;
+		m_legacy_offset = legacy_offset;
+		m_migrated = migrate? 0: Size;
+
+		m_named = 0;
+		for (uint8_t i = 0; i != Size; ++i)
+		{
+			record r;
+			if (migrate)
+				this->legacy_record(i, r);
+			else
+				this->load(i, r);
+			this->index(i, r);
+		}
+	}
+
+	bool migrating() const { return m_migrated != Size; }
+
+	// Writes the next converted record if the EEPROM queue is at most half
+	// full, leaving the rest to the other writers; the header follows the
+	// last one. Returns whether the migration goes on. A record takes 20
+	// byte writes of 8.5ms, so the whole book about 11s.
+	bool migrate_step()
+	{
+		if (!this->migrating())
+			return false;
+		if (m_eeprom.pending() + sizeof(record) > Eeprom::capacity / 2)
+			return true;
+
+		record r;
+		this->legacy_record(m_migrated, r);
+		if (r.version == 0xff)
+			m_eeprom.write(this->record_offset(m_migrated), uint8_t(0xff));
+		else
+			m_eeprom.write(this->record_offset(m_migrated), r);
+
+		if (++m_migrated == Size)
+		{
+			uint8_t const header[header_size] = { magic0, magic1, version };
+			m_eeprom.write(m_offset, header, header_size);
+		}
+		return this->migrating();
+	}
+
+	// Waits until the migration is written out.
+	void finish_migration()
+	{
+		while (this->migrate_step())
+		{
+		}
+	}
+
+	status_t status(uint8_t slot) const
+	{
+		return status_t(m_entries[slot].state);
+	}
+
+	uint8_t const * mac(uint8_t slot) const { return m_entries[slot].mac; }
+	uint8_t protocol(uint8_t slot) const { return m_entries[slot].protocol; }
+	uint8_t flags(uint8_t slot) const { return m_entries[slot].flags; }
+
+	// Reads the whole record from the EEPROM, e.g. for its name.
+	void load(uint8_t slot, record & r) const
+	{
+		m_eeprom.load(this->record_offset(slot), (uint8_t *)&r, sizeof r);
+	}
+
+	// The name is taken up to its terminating zero or name_length. Both
+	// store() and erase() complete a migration in progress first, so that
+	// it does not overwrite the slot later.
+	void store(uint8_t slot, uint8_t const * mac, char const * name, uint8_t protocol, uint8_t flags)
+	{
+		this->finish_migration();
+
+		record r;
+		make_record(r, mac, name, protocol, flags);
+		m_eeprom.write(this->record_offset(slot), r);
+		this->remove_name(slot);
+		this->index(slot, r);
+	}
+
+	void erase(uint8_t slot)
+	{
+		this->finish_migration();
+		m_eeprom.write(this->record_offset(slot), uint8_t(0xff));
+		this->remove_name(slot);
+		m_entries[slot].state = empty;
+	}
+
+	// The slot of the valid record with the name, or no_slot; a binary
+	// search over the hashes followed by comparing the candidates.
+	uint8_t find(char const * name, uint8_t len) const
+	{
+		if (len > name_length)
+			return no_slot;
+
+		uint16_t const h = hash(name, len);
+		uint8_t lo = 0;
+		uint8_t hi = m_named;
+		while (lo != hi)
+		{
+			uint8_t const mid = (lo + hi) / 2;
+			if (m_names[mid].hash < h)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (; lo != m_named && m_names[lo].hash == h; ++lo)
+		{
+			record r;
+			this->load(m_names[lo].slot, r);
+			uint8_t i = 0;
+			while (i != name_length && (i < len? name[i]: 0) == r.name[i])
+				++i;
+			if (i == name_length)
+				return m_names[lo].slot;
+		}
+		return no_slot;
+	}
+
+private:
+	static const uint8_t magic0 = 'Y';
+	static const uint8_t magic1 = 'B';
+
+	struct entry
+	{
+		uint8_t mac[6];
+		uint8_t protocol : 4;
+		uint8_t flags : 2;
+		uint8_t state : 2;
+	};
+
+	struct name_entry
+	{
+		uint16_t hash;
+		uint8_t slot;
+	};
+
+	uint16_t record_offset(uint8_t slot) const
+	{
+		return m_offset + header_size + slot * sizeof(record);
+	}
+
+	static void make_record(record & r, uint8_t const * mac, char const * name, uint8_t protocol, uint8_t flags)
+	{
+		r.version = version;
+		for (uint8_t i = 0; i != 6; ++i)
+			r.mac[i] = mac[i];
+		uint8_t len = 0;
+		for (; len != name_length && name[len] != 0; ++len)
+			r.name[len] = name[len];
+		for (uint8_t i = len; i != name_length; ++i)
+			r.name[i] = 0;
+		r.protocol = protocol & 0x0f;
+		r.flags = flags;
+		r.crc = crc(r);
+	}
+
+	static uint16_t crc(record const & r)
+	{
+		uint8_t const * p = (uint8_t const *)&r;
+		uint16_t res = 0xffff;
+		for (uint8_t i = 0; i != offsetof(record, crc); ++i)
+			res = _crc_ccitt_update(res, p[i]);
+		return res;
+	}
+
+	// Of the zero-padded name
+	static uint16_t hash(char const * name, uint8_t len)
+	{
+		uint16_t res = 0xffff;
+		for (uint8_t i = 0; i != name_length; ++i)
+			res = _crc_ccitt_update(res, i < len? name[i]: 0);
+		return res;
+	}
+
+	void index(uint8_t slot, record const & r)
+	{
+		entry & e = m_entries[slot];
+		if (r.version == 0xff)
+		{
+			e.state = empty;
+			return;
+		}
+
+		e.state = r.version == version && r.crc == crc(r)? valid: corrupt;
+		for (uint8_t i = 0; i != 6; ++i)
+			e.mac[i] = r.mac[i];
+		e.protocol = r.protocol;
+		e.flags = r.flags;
+		if (e.state == valid)
+			this->insert_name(hash(r.name, name_length), slot);
+	}
+
+	// Keeps the names sorted by their hashes
+	void insert_name(uint16_t h, uint8_t slot)
+	{
+		uint8_t i = m_named++;
+		for (; i != 0 && m_names[i - 1].hash > h; --i)
+			m_names[i] = m_names[i - 1];
+		m_names[i].hash = h;
+		m_names[i].slot = slot;
+	}
+
+	void remove_name(uint8_t slot)
+	{
+		uint8_t i = 0;
+		while (i != m_named && m_names[i].slot != slot)
+			++i;
+		if (i == m_named)
+			return;
+		for (--m_named; i != m_named; ++i)
+			m_names[i] = m_names[i + 1];
+	}
+
+	// The record the slot converts to, empty for an unused one. The legacy
+	// layout has six bytes per target, unused ones either all zeros or all
+	// ones. The header is written last, so an interrupted migration is
+	// repeated.
+	void legacy_record(uint8_t slot, record & r) const
+	{
+		uint8_t mac[6];
+		m_eeprom.load(m_legacy_offset + 6 * slot, mac, 6);
+
+		uint8_t ones = 0;
+		uint8_t zeros = 0;
+		for (uint8_t j = 0; j != 6; ++j)
+		{
+			ones += mac[j] == 0xff;
+			zeros += mac[j] == 0;
+		}
+
+		if (ones == 6 || zeros == 6)
+			r.version = 0xff;
+		else
+			make_record(r, mac, "", slot / 8 + 1, flag_migrated);
+	}
+
+	Eeprom & m_eeprom;
+	uint16_t m_offset;
+
+	entry m_entries[Size];
+	name_entry m_names[Size];
+	uint8_t m_named;
+
+	uint16_t m_legacy_offset;
+	uint8_t m_migrated;     // the slots written, Size when done
+};
+
+#endif
@@ -90,12 +90,22 @@ public:
 		ADCSRA = (1<<ADEN) | t;
 	}	
 
-	void start()
+	void select()
 	{
 		ADMUX = (m_left_adj<<ADLAR) | m_channel;
+	}
+
+	void start()
+	{
+		this->select();
 		ADCSRA |= (1<<ADSC);
 	}
 
+	static bool running()
+	{
+		return (ADCSRA & (1<<ADSC)) != 0;
+	}
+
 	bool process()
 	{
 		if ((ADCSRA & (1<<ADSC)) != 0)
@@ -121,6 +131,7 @@ public:
 	bool new_value() const { return m_new_value; }
 		
 	uint8_t channel() const { return m_channel; }
+	bool reverse() const { return m_reverse; }
 
 private:
 	uint8_t m_channel;
@@ -0,0 +1,170 @@
+#ifndef AVRLIB_ADC_SCANNER_HPP
+#define AVRLIB_ADC_SCANNER_HPP
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+namespace avrlib {
+
+// Round-robin scan over a set of ADC channels driven from the ADC
+// conversion complete interrupt.
+//
+// Each conversion is chained to the next channel directly in the
+// interrupt handler, so the sample rate is given by the ADC clock alone.
+// Every result is stored with the time of its completion and the sequence
+// number of the scan it belongs to. The sequence number is advanced after
+// the last channel of a scan.
+//
+// In the deferred mode the next conversion is only selected and it is up to
+// the caller to start it with start_deferred(), e.g. right before entering
+// the ADC noise reduction sleep.
+//
+// Adc is expected to behave like async_adc; intr() must be called from
+// ADC_vect and the ADC must have its interrupt enabled.
+template <typename Clock, typename Adc, uint8_t N>
+class adc_scanner
+{
+public:
+	typedef typename Clock::time_type time_type;
+	static const uint8_t channels = N;
+
+	struct sample
+	{
+		uint16_t value;
+		uint16_t scan;
+		time_type time;
+	};
+
+	adc_scanner(Clock const & clock, Adc (&adcs)[N])
+		: m_clock(clock), m_adcs(adcs), m_current(0), m_scan(0), m_ready(false),
+		m_deferred(false), m_pending(false)
+	{
+		for (uint8_t i = 0; i != N; ++i)
+		{
+			m_samples[i].value = 0;
+			m_samples[i].scan = 0;
+			m_samples[i].time = 0;
+		}
+	}
+
+	// Starts the first conversion; the rest is done by intr().
+	void start()
+	{
+		m_current = 0;
+		m_adcs[0].start();
+	}
+
+	// Returns true when the conversion completed a scan.
+	bool intr()
+	{
+		Adc & adc = m_adcs[m_current];
+		adc.process();
+
+		sample & s = m_samples[m_current];
+		s.value = adc.value();
+		s.scan = m_scan;
+		s.time = m_clock.value_nointr();
+
+		if (++m_current == N)
+		{
+			m_current = 0;
+			++m_scan;
+			m_ready = true;
+		}
+		if (m_deferred)
+		{
+			m_adcs[m_current].select();
+			m_pending = true;
+		}
+		else
+		{
+			m_adcs[m_current].start();
+		}
+		return m_current == 0;
+	}
+
+	void deferred(bool enable)
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		m_deferred = enable;
+		if (!enable)
+			this->start_deferred();
+		SREG = sreg;
+	}
+
+	bool deferred() const { return m_deferred; }
+
+	// Starts the selected conversion if it waits to be started. Must be
+	// called with interrupts disabled.
+	bool start_deferred()
+	{
+		if (!m_pending)
+			return false;
+		m_pending = false;
+		m_adcs[m_current].start();
+		return true;
+	}
+
+	// For use from the interrupt handler or with interrupts disabled.
+	sample const & operator[](uint8_t i) const { return m_samples[i]; }
+
+	// The last sample of the channel i. The getters leave the interrupt
+	// flag as they find it, so they work in critical sections too.
+	sample get(uint8_t i) const
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		sample res = m_samples[i];
+		SREG = sreg;
+		return res;
+	}
+
+	uint16_t value(uint8_t i) const
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		uint16_t res = m_samples[i].value;
+		SREG = sreg;
+		return res;
+	}
+
+	// Sequence number of the scan in progress; scans below it are complete.
+	uint16_t scan() const
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		uint16_t res = m_scan;
+		SREG = sreg;
+		return res;
+	}
+
+	// Tests whether a scan was completed since the last call to ack().
+	bool ready() const { return m_ready; }
+	void ack() { m_ready = false; }
+
+	// Waits until count more scans are complete.
+	void wait_scans(uint16_t count) const
+	{
+		uint16_t base = this->scan();
+		while (uint16_t(this->scan() - base) < count)
+		{
+		}
+	}
+
+private:
+	Clock const & m_clock;
+	Adc * m_adcs;
+
+	sample m_samples[N];
+	uint8_t m_current;
+	uint16_t m_scan;
+	volatile bool m_ready;
+	volatile bool m_deferred;
+	volatile bool m_pending;
+};
+
+}
+
+#endif
@@ -19,17 +19,20 @@ public:
 	typedef Bootseq bootseq_type;
 
 	async_usart()
+		: m_tx_count(0)
 	{
 	}
 
 	template <typename T1>
 	async_usart(T1 const & t1)
+		: m_tx_count(0)
 	{
 		m_usart.open(t1);
 	}
 
 	template <typename T1, typename T2>
 	async_usart(T1 const & t1, T2 const & t2)
+		: m_tx_count(0)
 	{
 		m_usart.open(t1, t2);
 	}
@@ -54,6 +57,12 @@ public:
 		return m_usart.transmitted();
 	}
 
+	// Nothing is queued or being shifted out.
+	bool tx_done() const
+	{
+		return m_tx_buffer.empty() && m_usart.tx_done();
+	}
+
 	value_type read()
 	{
 		while (m_rx_buffer.empty())
@@ -140,6 +149,7 @@ public:
 		{
 			m_usart.send(m_tx_buffer.top());
 			m_tx_buffer.pop();
+			++m_tx_count;
 			return true;
 		}
 
@@ -153,6 +163,7 @@ public:
 		{
 			m_usart.send(m_tx_buffer.top());
 			m_tx_buffer.pop();
+			++m_tx_count;
 			return true;
 		}
 		else
@@ -168,6 +179,11 @@ public:
 	}
 	
 	overflow_type overflow() const { return m_overflow; }
+
+	// Bytes handed to the USART so far, wrapping around; a byte queued
+	// now is handed over once the count has advanced by tx_buffer().size().
+	uint16_t tx_count() const { return m_tx_count; }
+
 	void clear_overflow() { m_overflow = 0; }
 
 	typedef buffer<value_type, RxBufferSize> rx_buffer_type;
@@ -189,6 +205,7 @@ private:
 	bootseq_type m_bootseq;
 	volatile overflow_type m_overflow;
 	volatile bool m_async_tx;
+	volatile uint16_t m_tx_count;
 };
 
 }
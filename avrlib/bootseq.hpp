@@ -15,6 +15,9 @@ inline void bootseq_reset()
 	BOOTSEQ_RESET();
 #else
 	cli();
+# ifdef BOOTSEQ_BEFORE_RESET
+	BOOTSEQ_BEFORE_RESET();
+# endif
 # if defined(WDTCR)
 #  if defined(WDCE)
 	WDTCR = (1<<WDCE)|(1<<WDE);
@@ -0,0 +1,78 @@
+#ifndef AVRLIB_CHANNEL_MAP_HPP
+#define AVRLIB_CHANNEL_MAP_HPP
+
+#include <stdint.h>
+#include "make_byte.hpp"
+
+namespace avrlib {
+
+enum channel_role
+{
+	channel_axis,
+	channel_trim,
+	channel_battery
+};
+
+namespace detail {
+
+template <channel_role R, channel_role... Roles>
+struct role_count
+{
+	static const uint8_t value = 0;
+};
+
+template <channel_role R, channel_role First, channel_role... Rest>
+struct role_count<R, First, Rest...>
+{
+	static const uint8_t value = (First == R) + role_count<R, Rest...>::value;
+};
+
+template <channel_role... Roles>
+struct roles_grouped
+{
+	static const bool value = true;
+};
+
+template <channel_role A, channel_role B, channel_role... Rest>
+struct roles_grouped<A, B, Rest...>
+{
+	static const bool value = A <= B && roles_grouped<B, Rest...>::value;
+};
+
+}
+
+// Compile-time description of the scanned analog inputs, listed in the
+// order of the scan. The roles must be grouped in the order of channel_role,
+// so that the channels of a role form a contiguous range; the axis i is
+// the channel i, the trim i is the channel first_trim + i and so on.
+template <channel_role... Roles>
+struct channel_map
+{
+	static const uint8_t size = sizeof...(Roles);
+	static const uint8_t axes = detail::role_count<channel_axis, Roles...>::value;
+	static const uint8_t trims = detail::role_count<channel_trim, Roles...>::value;
+	static const uint8_t batteries = detail::role_count<channel_battery, Roles...>::value;
+
+	static const uint8_t first_trim = axes;
+	static const uint8_t first_battery = axes + trims;
+
+	static_assert(detail::roles_grouped<Roles...>::value, "the channels must be grouped by their roles");
+};
+
+// Roles of the switches as returned by read_switches(): the bits below
+// Buttons are push buttons, the bit Connect holds the connection and
+// the bits T0, T1 and T2 select the target, the least significant first.
+template <uint8_t Buttons, uint8_t Connect, uint8_t T0, uint8_t T1 = no_bit, uint8_t T2 = no_bit>
+struct switch_map
+{
+	static const uint8_t buttons = Buttons;
+	static const uint8_t button_mask = (1<<Buttons) - 1;
+	static const uint8_t connect_mask = 1<<Connect;
+
+	static bool connect(uint8_t sw) { return (sw & connect_mask) != 0; }
+	static uint8_t target(uint8_t sw) { return bit_gather<T0, T1, T2>::apply(sw); }
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef AVRLIB_CONFIG_BLOCK_HPP
+#define AVRLIB_CONFIG_BLOCK_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <util/crc16.h>
+
+namespace avrlib {
+
+// RAM copy of a configuration structure T kept in the EEPROM, followed by
+// a CRC-CCITT of the Version and of the structure.
+//
+// load() reads the block once and all reads are served from the RAM. The
+// changes made by set() or replace() mark the bytes they change as dirty
+// in chunks of chunk_size bytes, which is a single field for most structures
+// of up to 32 bytes; flush() queues the dirty chunks and the CRC to Eeprom,
+// which is expected to behave like eeprom_writer. It is up to the caller to
+// defer the flush, so that a series of changes results in a single write.
+// A block failing its CRC, e.g. after a power loss during a flush or after
+// T changed with a new Version, is replaced by the defaults.
+template <typename Eeprom, typename T, uint8_t Version = 0>
+class config_block
+{
+public:
+	typedef T value_type;
+
+	static const uint8_t chunk_size = (sizeof(T) + 31) / 32;
+	static const uint8_t chunks = (sizeof(T) + chunk_size - 1) / chunk_size;
+	static const uint16_t eeprom_size = sizeof(T) + 2;
+
+	static_assert(sizeof(T) <= 255 * 32, "the structure is too large");
+
+	config_block(Eeprom & eeprom, uint16_t offset)
+		: m_eeprom(eeprom), m_offset(offset), m_dirty(0)
+	{
+	}
+
+	// Returns false if the defaults were taken; all of them are dirty then.
+	bool load(T const & defaults)
+	{
+		m_eeprom.load(m_offset, (uint8_t *)&m_data, sizeof m_data);
+		uint16_t crc;
+		if (m_eeprom.load(m_offset + sizeof m_data, crc) == this->crc())
+		{
+			m_dirty = 0;
+			return true;
+		}
+
+		m_data = defaults;
+		m_dirty = (uint32_t(1) << (chunks - 1) << 1) - 1;
+		return false;
+	}
+
+	T const & get() const { return m_data; }
+	T const * operator->() const { return &m_data; }
+
+	template <typename F>
+	void set(F T::*field, F const & value)
+	{
+		this->assign(m_data.*field, value);
+	}
+
+	template <typename F, size_t N>
+	void set(F (T::*field)[N], uint8_t i, F const & value)
+	{
+		this->assign((m_data.*field)[i], value);
+	}
+
+	// Only the chunks that differ become dirty.
+	void replace(T const & value)
+	{
+		uint8_t * p = (uint8_t *)&m_data;
+		uint8_t const * q = (uint8_t const *)&value;
+		for (uint16_t i = 0; i != sizeof(T); ++i)
+		{
+			if (p[i] == q[i])
+				continue;
+			p[i] = q[i];
+			m_dirty |= uint32_t(1) << (i / chunk_size);
+		}
+	}
+
+	bool dirty() const { return m_dirty != 0; }
+	uint32_t dirty_chunks() const { return m_dirty; }
+
+	// Queues the dirty chunks and then the CRC.
+	void flush()
+	{
+		if (m_dirty == 0)
+			return;
+
+		uint8_t const * p = (uint8_t const *)&m_data;
+		for (uint8_t i = 0; i != chunks; ++i)
+		{
+			if ((m_dirty & (uint32_t(1) << i)) == 0)
+				continue;
+			uint16_t const offset = i * chunk_size;
+			uint8_t const len = sizeof(T) - offset < chunk_size? sizeof(T) - offset: chunk_size;
+			m_eeprom.write(m_offset + offset, p + offset, len);
+		}
+		m_eeprom.write(m_offset + sizeof m_data, this->crc());
+		m_dirty = 0;
+	}
+
+private:
+	template <typename F>
+	void assign(F & field, F const & value)
+	{
+		if (memcmp(&field, &value, sizeof field) == 0)
+			return;
+		field = value;
+
+		uint8_t const * const base = (uint8_t const *)&m_data;
+		uint8_t const * const p = (uint8_t const *)&field;
+		uint8_t const first = (p - base) / chunk_size;
+		uint8_t const last = (p - base + sizeof field - 1) / chunk_size;
+		for (uint8_t i = first; i <= last; ++i)
+			m_dirty |= uint32_t(1) << i;
+	}
+
+	uint16_t crc() const
+	{
+		uint8_t const * p = (uint8_t const *)&m_data;
+		uint16_t res = _crc_ccitt_update(0xffff, Version);
+		for (uint16_t i = 0; i != sizeof m_data; ++i)
+			res = _crc_ccitt_update(res, p[i]);
+		return res;
+	}
+
+	Eeprom & m_eeprom;
+	uint16_t m_offset;
+	T m_data;
+	uint32_t m_dirty;
+};
+
+}
+
+#endif
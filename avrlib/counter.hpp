@@ -78,6 +78,47 @@ struct counter
 	
 	inline time_type operator()() const { return value(); }
 
+	// Same as value(), but for callers running with interrupts disabled
+	// (e.g. other interrupt handlers), where the loop above would never end.
+	// A pending overflow is accounted for instead of being waited for.
+	time_type value_nointr() const
+	{
+		typename timer_type::time_type time = timer_type::value();
+		overflow_type overflows = m_overflows;
+
+		if (timer_type::overflow())
+		{
+			time = timer_type::value();
+			++overflows;
+		}
+
+		if(full_bit_period)
+			return (time_type(overflows) << timer_type::value_bits) | time;
+		else
+			return (time_type(overflows) * timer_type::top()) + time;
+	}
+
+	// Adds ticks that were missed while the timer was stopped, e.g. while
+	// its clock was halted in a sleep mode. Must be called with interrupts
+	// disabled. A tick that falls between the read and the write of the
+	// timer is lost, i.e. a call loses one with the odds of a few cycles
+	// in a prescaler period.
+	void advance(typename timer_type::time_type ticks)
+	{
+		typename timer_type::time_type const t = timer_type::value();
+		typename timer_type::time_type const n = t + ticks;
+		timer_type::value(n);
+		if (n < t)
+			++m_overflows;
+	}
+
+	// Presets the overflow count, e.g. to start the time right before its
+	// wraparound. Must be called with interrupts disabled.
+	void overflows(overflow_type v)
+	{
+		m_overflows = v;
+	}
+
 	void tov_interrupt() const
 	{
 		++static_cast<overflow_type volatile &>(m_overflows);
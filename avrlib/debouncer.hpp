@@ -0,0 +1,82 @@
+#ifndef AVRLIB_DEBOUNCER_HPP
+#define AVRLIB_DEBOUNCER_HPP
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+namespace avrlib {
+
+// Debounces 8 inputs in parallel using 2-bit vertical counters. An input
+// takes on a new state after 4 consecutive samples that differ from the
+// current one; any sample agreeing with the state restarts its count.
+//
+// The edges are accumulated until they are taken, so they are not lost if
+// sample() runs in an interrupt handler more often than they are polled.
+// Taking them leaves the interrupt flag as it was.
+class debouncer
+{
+public:
+	debouncer()
+	{
+		this->reset(0);
+	}
+
+	void reset(uint8_t state)
+	{
+		m_state = state;
+		m_ct0 = 0xff;
+		m_ct1 = 0xff;
+		m_pressed = 0;
+		m_released = 0;
+	}
+
+	// Returns the inputs whose debounced state has changed.
+	uint8_t sample(uint8_t v)
+	{
+		uint8_t changed = m_state ^ v;
+		m_ct0 = ~(m_ct0 & changed);
+		m_ct1 = m_ct0 ^ (m_ct1 & changed);
+		changed &= m_ct0 & m_ct1;
+
+		m_state ^= changed;
+		m_pressed |= m_state & changed;
+		m_released |= ~m_state & changed;
+		return changed;
+	}
+
+	uint8_t state() const { return m_state; }
+
+	// Inputs that went to 1 since the last call.
+	uint8_t take_pressed()
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		uint8_t res = m_pressed;
+		m_pressed = 0;
+		SREG = sreg;
+		return res;
+	}
+
+	// Inputs that went to 0 since the last call.
+	uint8_t take_released()
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		uint8_t res = m_released;
+		m_released = 0;
+		SREG = sreg;
+		return res;
+	}
+
+private:
+	volatile uint8_t m_state;
+	uint8_t m_ct0;
+	uint8_t m_ct1;
+	volatile uint8_t m_pressed;
+	volatile uint8_t m_released;
+};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define AVRLIB_EEPROM_HPP
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 
 namespace avrlib {
 
@@ -72,6 +73,193 @@ void store_eeprom(uint16_t address, T value)
 	store_eeprom(address, (uint8_t const *)&value, sizeof value);
 }
 
+#ifndef EEMWE
+# define AVRLIB_EEMWE EEMPE
+# define AVRLIB_EEWE EEPE
+#else
+# define AVRLIB_EEMWE EEMWE
+# define AVRLIB_EEWE EEWE
+#endif
+
+// Writes to the EEPROM in the background, one byte per EEPROM ready
+// interrupt; intr() must be called from EE_READY_vect.
+//
+// write() queues the bytes and returns at once, unless the queue is full.
+// Before a byte is written, its cell is read and the write is skipped if
+// the value is already there, saving both the 8.5ms and the wear. load()
+// sees the queued values. Neither load_eeprom() nor store_eeprom() may be
+// used while the queue is in use.
+template <uint8_t Capacity>
+class eeprom_writer
+{
+public:
+	static const uint8_t capacity = Capacity;
+	static_assert(Capacity >= 2 && Capacity <= 128, "unsupported queue capacity");
+
+	eeprom_writer()
+		: m_rptr(0), m_wptr(0), m_written(0), m_skipped(0)
+	{
+	}
+
+	// Waits while the queue is full.
+	void write(uint16_t address, uint8_t value)
+	{
+		for (;;)
+		{
+			cli();
+			if (next(m_wptr) != m_rptr)
+				break;
+			sei();
+		}
+
+		entry & e = m_entries[m_wptr];
+		e.address = address & E2END;
+		e.value = value;
+		m_wptr = next(m_wptr);
+		EECR |= (1<<EERIE);
+		sei();
+	}
+
+	void write(uint16_t address, uint8_t const * ptr, uint8_t len)
+	{
+		for (; len != 0; --len)
+			this->write(address++, *ptr++);
+	}
+
+	template <typename T>
+	void write(uint16_t address, T const & value)
+	{
+		this->write(address, (uint8_t const *)&value, sizeof value);
+	}
+
+	// Reads the cells, waiting for the write in progress, and overlays
+	// the values still queued for them.
+	void load(uint16_t address, uint8_t * ptr, uint8_t len) const
+	{
+		for (; len != 0; --len, ++ptr, ++address)
+		{
+			address &= E2END;
+			for (;;)
+			{
+				cli();
+				if ((EECR & (1<<AVRLIB_EEWE)) == 0)
+					break;
+				sei();
+			}
+
+			*ptr = read_cell(address);
+			for (uint8_t i = m_rptr; i != m_wptr; i = next(i))
+			{
+				if (m_entries[i].address == address)
+					*ptr = m_entries[i].value;
+			}
+			sei();
+		}
+	}
+
+	template <typename T>
+	T load(uint16_t address, T & data) const
+	{
+		this->load(address, (uint8_t *)&data, sizeof data);
+		return data;
+	}
+
+	// Bytes waiting in the queue, not counting the one being written.
+	uint8_t pending() const
+	{
+		cli();
+		uint8_t res = m_wptr - m_rptr;
+		sei();
+		return res < Capacity? res: uint8_t(res + Capacity);
+	}
+
+	bool busy() const
+	{
+		return m_rptr != m_wptr || (EECR & (1<<AVRLIB_EEWE)) != 0;
+	}
+
+	// Waits until everything is written; the interrupts must be enabled.
+	void flush() const
+	{
+		while (this->busy())
+		{
+		}
+	}
+
+	// Writes everything out by polling; for use with the interrupts
+	// disabled, e.g. right before a reset.
+	void flush_nointr()
+	{
+		for (;;)
+		{
+			while (EECR & (1<<AVRLIB_EEWE))
+			{
+			}
+			if (m_rptr == m_wptr)
+				break;
+			this->intr();
+		}
+	}
+
+	// Starts the next write that changes the cell or disables
+	// the interrupt once the queue is empty.
+	void intr()
+	{
+		while (m_rptr != m_wptr)
+		{
+			entry const & e = m_entries[m_rptr];
+			m_rptr = next(m_rptr);
+
+			if (read_cell(e.address) == e.value)
+			{
+				++m_skipped;
+				continue;
+			}
+
+			EEDR = e.value;
+			EECR = (1<<EERIE)|(1<<AVRLIB_EEMWE);
+			EECR = (1<<EERIE)|(1<<AVRLIB_EEWE);
+			++m_written;
+			return;
+		}
+		EECR = 0;
+	}
+
+	uint16_t written() const { return m_written; }
+	uint16_t skipped() const { return m_skipped; }
+	void clear_stats() { m_written = 0; m_skipped = 0; }
+
+private:
+	struct entry
+	{
+		uint16_t address;
+		uint8_t value;
+	};
+
+	static uint8_t next(uint8_t i)
+	{
+		return i + 1 == Capacity? 0: i + 1;
+	}
+
+	// Leaves the address set for a subsequent write.
+	static uint8_t read_cell(uint16_t address)
+	{
+		EEARL = address & 0xFF;
+		EEARH = address >> 8;
+		EECR = (EECR & (1<<EERIE)) | (1<<EERE);
+		return EEDR;
+	}
+
+	entry m_entries[Capacity];
+	volatile uint8_t m_rptr;
+	volatile uint8_t m_wptr;
+	uint16_t m_written;
+	uint16_t m_skipped;
+};
+
+#undef AVRLIB_EEMWE
+#undef AVRLIB_EEWE
+
 }
 
 #endif
@@ -0,0 +1,203 @@
+#ifndef AVRLIB_EEPROM_LOG_HPP
+#define AVRLIB_EEPROM_LOG_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <util/crc16.h>
+
+namespace avrlib {
+
+struct eeprom_log_record
+{
+	uint8_t key;
+	uint16_t seq;
+	uint32_t value;
+	uint16_t crc;
+};
+
+// Wear-leveled key/value store over Slots fixed-size records in the EEPROM.
+//
+// The records form a ring that is only ever appended to: every record holds
+// a key, a 32-bit value, a sequence number and a CRC-CCITT, and the newest
+// valid record of a key holds its value. Before the head catches up with
+// the oldest live record, the tail is compacted, i.e. the live records at
+// it are appended again, so all the slots are written in turns and the
+// sequence numbers stay within one lap of each other.
+//
+// A record cut short by a power loss fails its CRC and the previous value
+// of its key remains in another slot. init() recovers the values, the head
+// and the tail in a single scan. The values are cached in RAM; Eeprom is
+// expected to behave like eeprom_writer.
+template <typename Eeprom, uint8_t Keys, uint8_t Slots>
+class eeprom_log
+{
+public:
+	static const uint8_t keys = Keys;
+	static const uint8_t slots = Slots;
+	static const uint8_t no_slot = 0xff;
+
+	static_assert(Keys < 0xff && Slots < 0xff, "the keys and the slots must fit into a byte");
+	static_assert(Slots > 2 * Keys + 1, "the log must have room for moving all the keys");
+
+	typedef eeprom_log_record record;
+
+	static const uint16_t eeprom_size = Slots * sizeof(record);
+
+	eeprom_log(Eeprom & eeprom, uint16_t offset)
+		: m_eeprom(eeprom), m_offset(offset), m_head(0), m_tail(0), m_seq(0), m_writes(0)
+	{
+		for (uint8_t i = 0; i != Keys; ++i)
+			m_slot[i] = no_slot;
+	}
+
+	void init()
+	{
+		uint16_t seqs[Keys];
+		uint8_t newest = no_slot;
+		for (uint8_t i = 0; i != Keys; ++i)
+			m_slot[i] = no_slot;
+
+		for (uint8_t slot = 0; slot != Slots; ++slot)
+		{
+			record r;
+			this->load(slot, r);
+			if (r.key >= Keys || r.crc != crc(r))
+				continue;
+
+			if (newest == no_slot || int16_t(r.seq - m_seq) > 0)
+			{
+				newest = slot;
+				m_seq = r.seq;
+			}
+
+			if (m_slot[r.key] == no_slot || int16_t(r.seq - seqs[r.key]) > 0)
+			{
+				m_slot[r.key] = slot;
+				m_values[r.key] = r.value;
+				seqs[r.key] = r.seq;
+			}
+		}
+
+		m_head = newest == no_slot? 0: next(newest);
+		m_tail = m_head;
+		for (uint8_t i = 0; i != Slots && !this->live(m_tail); ++i)
+			m_tail = next(m_tail);
+		if (!this->live(m_tail))
+			m_tail = m_head;
+	}
+
+	bool get(uint8_t key, uint32_t & value) const
+	{
+		if (m_slot[key] == no_slot)
+			return false;
+		value = m_values[key];
+		return true;
+	}
+
+	// The value of the key or def if it has none
+	uint32_t value(uint8_t key, uint32_t def) const
+	{
+		this->get(key, def);
+		return def;
+	}
+
+	// Appends the value unless the key holds it already.
+	void set(uint8_t key, uint32_t value)
+	{
+		if (m_slot[key] != no_slot && m_values[key] == value)
+			return;
+
+		while (this->free() <= Keys)
+			this->compact();
+		this->append(key, value);
+	}
+
+	uint8_t head() const { return m_head; }
+	uint8_t tail() const { return m_tail; }
+	uint16_t sequence() const { return m_seq; }
+	uint8_t slot(uint8_t key) const { return m_slot[key]; }
+
+	// Records written since the start, including the moved ones
+	uint16_t writes() const { return m_writes; }
+
+private:
+	static uint8_t next(uint8_t slot)
+	{
+		return slot + 1 == Slots? 0: slot + 1;
+	}
+
+	static uint16_t crc(record const & r)
+	{
+		uint8_t const * p = (uint8_t const *)&r;
+		uint16_t res = 0xffff;
+		for (uint8_t i = 0; i != offsetof(record, crc); ++i)
+			res = _crc_ccitt_update(res, p[i]);
+		return res;
+	}
+
+	void load(uint8_t slot, record & r) const
+	{
+		m_eeprom.load(m_offset + slot * sizeof(record), (uint8_t *)&r, sizeof r);
+	}
+
+	// The key whose newest record is in the slot, or Keys
+	uint8_t owner(uint8_t slot) const
+	{
+		uint8_t key = 0;
+		while (key != Keys && m_slot[key] != slot)
+			++key;
+		return key;
+	}
+
+	bool live(uint8_t slot) const
+	{
+		return this->owner(slot) != Keys;
+	}
+
+	uint8_t free() const
+	{
+		if (m_head == m_tail)
+			return this->live(m_tail)? 0: Slots;
+		return m_tail > m_head? m_tail - m_head: Slots - (m_head - m_tail);
+	}
+
+	void append(uint8_t key, uint32_t value)
+	{
+		record r;
+		r.key = key;
+		r.seq = ++m_seq;
+		r.value = value;
+		r.crc = crc(r);
+		m_eeprom.write(m_offset + m_head * sizeof(record), r);
+		++m_writes;
+
+		m_slot[key] = m_head;
+		m_values[key] = value;
+		m_head = next(m_head);
+	}
+
+	// Moves the tail on by a slot, appending its record again if it is live.
+	void compact()
+	{
+		uint8_t const slot = m_tail;
+		m_tail = next(m_tail);
+		uint8_t const key = this->owner(slot);
+		if (key != Keys)
+			this->append(key, m_values[key]);
+	}
+
+	Eeprom & m_eeprom;
+	uint16_t m_offset;
+
+	uint8_t m_head;
+	uint8_t m_tail;
+	uint16_t m_seq;
+	uint16_t m_writes;
+
+	uint8_t m_slot[Keys];
+	uint32_t m_values[Keys];
+};
+
+}
+
+#endif
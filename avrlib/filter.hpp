@@ -0,0 +1,170 @@
+#ifndef AVRLIB_FILTER_HPP
+#define AVRLIB_FILTER_HPP
+
+#include <stdint.h>
+#include "fixedpoint.hpp"
+
+namespace avrlib {
+
+namespace detail {
+
+constexpr uint8_t log2(uint8_t n)
+{
+	return n <= 1? 0: 1 + log2(n / 2);
+}
+
+}
+
+// First-order low-pass filter y += (x - y) / 2^Shift.
+//
+// The state keeps Frac fractional bits, so that small steps are not lost
+// to truncation; the output is rounded to nearest.
+template <typename T, uint8_t Shift, uint8_t Frac = 8>
+class iir_filter
+{
+public:
+	typedef T value_type;
+	typedef fixedpoint<int32_t, Frac> state_type;
+
+	iir_filter()
+		: m_state(0), m_primed(false)
+	{
+	}
+
+	// Starts over at v without a transient.
+	void reset(value_type v)
+	{
+		m_state = state_type(int32_t(v));
+		m_primed = true;
+	}
+
+	value_type operator()(value_type v)
+	{
+		if (!m_primed)
+		{
+			this->reset(v);
+			return v;
+		}
+
+		int32_t diff = state_type(int32_t(v)).get_raw() - m_state.get_raw();
+		m_state += state_type(diff >> Shift, Frac);
+		return this->value();
+	}
+
+	value_type value() const
+	{
+		return value_type((m_state.get_raw() + (int32_t(1) << (Frac - 1))) >> Frac);
+	}
+
+private:
+	state_type m_state;
+	bool m_primed;
+};
+
+// Median of the last three samples; removes single-sample spikes.
+template <typename T>
+class median3_filter
+{
+public:
+	typedef T value_type;
+
+	median3_filter()
+		: m_value(0), m_primed(false)
+	{
+		m_prev[0] = 0;
+		m_prev[1] = 0;
+	}
+
+	void reset(value_type v)
+	{
+		m_prev[0] = v;
+		m_prev[1] = v;
+		m_primed = true;
+	}
+
+	value_type operator()(value_type v)
+	{
+		if (!m_primed)
+			this->reset(v);
+
+		value_type a = m_prev[0];
+		value_type b = m_prev[1];
+		m_prev[0] = b;
+		m_prev[1] = v;
+
+		if (a > b)
+		{
+			value_type t = a;
+			a = b;
+			b = t;
+		}
+		m_value = v < a? a: v > b? b: v;
+		return m_value;
+	}
+
+	value_type value() const { return m_value; }
+
+private:
+	value_type m_prev[2];
+	value_type m_value;
+	bool m_primed;
+};
+
+// Passes the samples through unchanged.
+template <typename T>
+class null_filter
+{
+public:
+	typedef T value_type;
+
+	null_filter()
+		: m_value(0)
+	{
+	}
+
+	void reset(value_type v) { m_value = v; }
+	value_type operator()(value_type v) { return m_value = v; }
+	value_type value() const { return m_value; }
+
+private:
+	value_type m_value;
+};
+
+// Averages blocks of N samples, N being a power of two, and feeds the means
+// to Filter. add() returns true whenever a new output is available.
+template <uint8_t N, typename Filter, typename Acc = int32_t>
+class oversampled_filter
+{
+public:
+	typedef typename Filter::value_type value_type;
+	static const uint8_t oversampling = N;
+
+	oversampled_filter()
+		: m_sum(0), m_count(0)
+	{
+	}
+
+	bool add(value_type v)
+	{
+		m_sum += v;
+		if (++m_count != N)
+			return false;
+
+		value_type mean = value_type((m_sum + (Acc(N) >> 1)) >> detail::log2(N));
+		m_sum = 0;
+		m_count = 0;
+		m_filter(mean);
+		return true;
+	}
+
+	value_type value() const { return m_filter.value(); }
+
+private:
+	Acc m_sum;
+	uint8_t m_count;
+	Filter m_filter;
+};
+
+}
+
+#endif
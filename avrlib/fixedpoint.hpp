@@ -1,6 +1,8 @@
 #ifndef AVRLIB_FIXEDPOINT_HPP
 #define AVRLIB_FIXEDPOINT_HPP
 
+#include <stdint.h>
+
 namespace avrlib {
 
 template <typename T, int exp>
@@ -98,6 +100,51 @@ fixedpoint<T, exp> make_fixedpoint(T value, int valexp = exp)
 	return fixedpoint<T, exp>(value, valexp);
 }
 
+// Multiplies by a fixed-point factor, rounds the product to nearest (halves
+// away from zero) and saturates it to [-32767, 32767]. T must be at most
+// 16 bits wide.
+template <typename T, int exp>
+int16_t mul_sat(int16_t lhs, fixedpoint<T, exp> const & rhs)
+{
+	int32_t r = int32_t(lhs) * rhs.get_raw();
+	int32_t const half = int32_t(1) << (exp - 1);
+	r = r < 0? -((half - r) >> exp): (r + half) >> exp;
+	return r > 32767? 32767: r < -32767? -32767: int16_t(r);
+}
+
+namespace detail {
+
+template <typename T>
+T fixed_max()
+{
+	return T(~T(0)) > T(0)? T(~T(0)): T(~(T(1) << (sizeof(T) * 8 - 1)));
+}
+
+}
+
+// The quotient num / den rounded to nearest and saturated to the range of
+// the fixed-point type; both operands must be positive.
+template <typename T, int exp>
+fixedpoint<T, exp> div_sat(int32_t num, int32_t den)
+{
+	T const max = detail::fixed_max<T>();
+	int32_t q = ((num << exp) + den / 2) / den;
+	return fixedpoint<T, exp>(q > int32_t(max)? max: T(q), exp);
+}
+
+// The gain mapping extent to 32767 with mul_sat(); it is rounded up if
+// needed, so that the end of the range saturates rather than falls short.
+template <typename T, int exp>
+fixedpoint<T, exp> full_scale_gain(int16_t extent)
+{
+	if (extent < 1)
+		extent = 1;
+	fixedpoint<T, exp> g = div_sat<T, exp>(32767, extent);
+	if (mul_sat(extent, g) < 32767 && g.get_raw() != detail::fixed_max<T>())
+		g = fixedpoint<T, exp>(T(g.get_raw() + 1), exp);
+	return g;
+}
+
 }
 
 #endif
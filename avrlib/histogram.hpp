@@ -0,0 +1,155 @@
+#ifndef AVRLIB_HISTOGRAM_HPP
+#define AVRLIB_HISTOGRAM_HPP
+
+#include <stdint.h>
+
+namespace avrlib {
+
+// Linear histogram with Bins bins of equal width starting at base. Values
+// below or above the covered range are counted in the first or last bin
+// respectively, the extremes are tracked separately.
+template <typename T, uint8_t Bins, typename Count = uint16_t>
+class histogram
+{
+public:
+	typedef T value_type;
+	typedef Count count_type;
+	static const uint8_t bins = Bins;
+
+	histogram()
+		: m_base(0), m_width(1)
+	{
+		this->clear();
+	}
+
+	histogram(value_type base, value_type width)
+		: m_base(base), m_width(width)
+	{
+		this->clear();
+	}
+
+	void range(value_type base, value_type width)
+	{
+		m_base = base;
+		m_width = width;
+		this->clear();
+	}
+
+	void clear()
+	{
+		for (uint8_t i = 0; i != Bins; ++i)
+			m_bins[i] = 0;
+		m_count = 0;
+		m_min = 0;
+		m_max = 0;
+	}
+
+	void add(value_type v)
+	{
+		uint8_t bin = 0;
+		if (v >= m_base)
+		{
+			value_type i = (v - m_base) / m_width;
+			bin = i < Bins? i: Bins - 1;
+		}
+
+		if (m_bins[bin] != count_type(~count_type(0)))
+			++m_bins[bin];
+
+		if (m_count == 0 || v < m_min)
+			m_min = v;
+		if (m_count == 0 || v > m_max)
+			m_max = v;
+		if (m_count != uint32_t(~uint32_t(0)))
+			++m_count;
+	}
+
+	count_type operator[](uint8_t i) const { return m_bins[i]; }
+
+	// Lower bound of the bin i
+	value_type bin_base(uint8_t i) const { return m_base + i * m_width; }
+
+	value_type base() const { return m_base; }
+	value_type width() const { return m_width; }
+	uint32_t count() const { return m_count; }
+	value_type min() const { return m_min; }
+	value_type max() const { return m_max; }
+
+private:
+	value_type m_base;
+	value_type m_width;
+	count_type m_bins[Bins];
+	uint32_t m_count;
+	value_type m_min;
+	value_type m_max;
+};
+
+// Histogram of unsigned values by their bit length: the bin 0 counts the
+// zeros and the bin i the values in [2^(i-1), 2^i), the last bin also
+// those above. Adding a value costs a shift per bit; the sum is kept for
+// the mean.
+template <typename T, uint8_t Bins, typename Count = uint16_t>
+class log2_histogram
+{
+public:
+	typedef T value_type;
+	typedef Count count_type;
+	static const uint8_t bins = Bins;
+
+	log2_histogram()
+	{
+		this->clear();
+	}
+
+	void clear()
+	{
+		for (uint8_t i = 0; i != Bins; ++i)
+			m_bins[i] = 0;
+		m_count = 0;
+		m_sum = 0;
+		m_min = 0;
+		m_max = 0;
+	}
+
+	void add(value_type v)
+	{
+		uint8_t bin = 0;
+		for (value_type x = v; x != 0 && bin != Bins - 1; x >>= 1)
+			++bin;
+
+		if (m_bins[bin] != count_type(~count_type(0)))
+			++m_bins[bin];
+
+		if (m_count == 0 || v < m_min)
+			m_min = v;
+		if (m_count == 0 || v > m_max)
+			m_max = v;
+		if (m_count != uint32_t(~uint32_t(0)))
+		{
+			++m_count;
+			m_sum += v;
+		}
+	}
+
+	count_type operator[](uint8_t i) const { return m_bins[i]; }
+
+	// Lower bound of the bin i
+	static value_type bin_base(uint8_t i) { return i == 0? 0: value_type(1) << (i - 1); }
+
+	uint32_t count() const { return m_count; }
+	uint32_t sum() const { return m_sum; }
+	value_type min() const { return m_min; }
+	value_type max() const { return m_max; }
+	value_type mean() const { return m_count == 0? 0: value_type(m_sum / m_count); }
+
+private:
+	count_type m_bins[Bins];
+	uint32_t m_count;
+	uint32_t m_sum;
+	value_type m_min;
+	value_type m_max;
+};
+
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef AVRLIB_HOST_AVR_INTERRUPT_H
+#define AVRLIB_HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define sei() (::avrlib::host::sei())
+#define cli() (::avrlib::host::cli())
+
+// The handlers are entered into the vector table of the machine before
+// main() runs.
+#define ISR(vector, ...) \
+	extern "C" void vector(void); \
+	static ::avrlib::host::isr_entry const vector ## _entry(vector ## _num, &vector); \
+	extern "C" void vector(void)
+
+#define EMPTY_INTERRUPT(vector) \
+	extern "C" void vector(void); \
+	static ::avrlib::host::isr_entry const vector ## _entry(vector ## _num, &vector); \
+	extern "C" void vector(void) {}
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+
+#endif
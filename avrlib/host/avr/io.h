@@ -0,0 +1,456 @@
+#ifndef AVRLIB_HOST_AVR_IO_H
+#define AVRLIB_HOST_AVR_IO_H
+#define _AVR_IO_H_ 1
+
+// Set for the code that has to tell the host build apart
+#define AVRLIB_HOST 1
+
+// The registers of the ATmega128 at their data memory addresses, as in
+// avr-libc, backed by the machine of the host build.
+
+#ifndef __AVR_ATmega128__
+# error The host build only models the ATmega128.
+#endif
+
+#include <stdint.h>
+#include "../simulator.hpp"
+
+#define _BV(bit) (1 << (bit))
+#define _SFR_MEM8(addr) (::avrlib::host::reg8<(addr)>{})
+#define _SFR_MEM16(addr) (::avrlib::host::reg16<(addr)>{})
+#define _SFR_IO8(addr) _SFR_MEM8((addr) + 0x20)
+#define _SFR_IO16(addr) _SFR_MEM16((addr) + 0x20)
+
+#define bit_is_set(sfr, bit) (uint8_t(sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!(uint8_t(sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit) do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+#define PINF _SFR_IO8(0x00)
+#define PINE _SFR_IO8(0x01)
+#define DDRE _SFR_IO8(0x02)
+#define PORTE _SFR_IO8(0x03)
+#define ADCW _SFR_IO16(0x04)
+#define ADC ADCW
+#define ADCL _SFR_IO8(0x04)
+#define ADCH _SFR_IO8(0x05)
+#define ADCSRA _SFR_IO8(0x06)
+#define ADCSR ADCSRA
+#define ADMUX _SFR_IO8(0x07)
+#define ACSR _SFR_IO8(0x08)
+#define UBRR0L _SFR_IO8(0x09)
+#define UCSR0B _SFR_IO8(0x0A)
+#define UCSR0A _SFR_IO8(0x0B)
+#define UDR0 _SFR_IO8(0x0C)
+#define SPCR _SFR_IO8(0x0D)
+#define SPSR _SFR_IO8(0x0E)
+#define SPDR _SFR_IO8(0x0F)
+#define PIND _SFR_IO8(0x10)
+#define DDRD _SFR_IO8(0x11)
+#define PORTD _SFR_IO8(0x12)
+#define PINC _SFR_IO8(0x13)
+#define DDRC _SFR_IO8(0x14)
+#define PORTC _SFR_IO8(0x15)
+#define PINB _SFR_IO8(0x16)
+#define DDRB _SFR_IO8(0x17)
+#define PORTB _SFR_IO8(0x18)
+#define PINA _SFR_IO8(0x19)
+#define DDRA _SFR_IO8(0x1A)
+#define PORTA _SFR_IO8(0x1B)
+#define EECR _SFR_IO8(0x1C)
+#define EEDR _SFR_IO8(0x1D)
+#define EEAR _SFR_IO16(0x1E)
+#define EEARL _SFR_IO8(0x1E)
+#define EEARH _SFR_IO8(0x1F)
+#define SFIOR _SFR_IO8(0x20)
+#define WDTCR _SFR_IO8(0x21)
+#define OCDR _SFR_IO8(0x22)
+#define OCR2 _SFR_IO8(0x23)
+#define TCNT2 _SFR_IO8(0x24)
+#define TCCR2 _SFR_IO8(0x25)
+#define ICR1 _SFR_IO16(0x26)
+#define ICR1L _SFR_IO8(0x26)
+#define ICR1H _SFR_IO8(0x27)
+#define OCR1B _SFR_IO16(0x28)
+#define OCR1BL _SFR_IO8(0x28)
+#define OCR1BH _SFR_IO8(0x29)
+#define OCR1A _SFR_IO16(0x2A)
+#define OCR1AL _SFR_IO8(0x2A)
+#define OCR1AH _SFR_IO8(0x2B)
+#define TCNT1 _SFR_IO16(0x2C)
+#define TCNT1L _SFR_IO8(0x2C)
+#define TCNT1H _SFR_IO8(0x2D)
+#define TCCR1B _SFR_IO8(0x2E)
+#define TCCR1A _SFR_IO8(0x2F)
+#define ASSR _SFR_IO8(0x30)
+#define OCR0 _SFR_IO8(0x31)
+#define TCNT0 _SFR_IO8(0x32)
+#define TCCR0 _SFR_IO8(0x33)
+#define MCUCSR _SFR_IO8(0x34)
+#define MCUCR _SFR_IO8(0x35)
+#define TIFR _SFR_IO8(0x36)
+#define TIMSK _SFR_IO8(0x37)
+#define EIFR _SFR_IO8(0x38)
+#define EIMSK _SFR_IO8(0x39)
+#define EICRB _SFR_IO8(0x3A)
+#define RAMPZ _SFR_IO8(0x3B)
+#define XDIV _SFR_IO8(0x3C)
+#define SP _SFR_IO16(0x3D)
+#define SPL _SFR_IO8(0x3D)
+#define SPH _SFR_IO8(0x3E)
+#define SREG _SFR_IO8(0x3F)
+
+#define DDRF _SFR_MEM8(0x61)
+#define PORTF _SFR_MEM8(0x62)
+#define PING _SFR_MEM8(0x63)
+#define DDRG _SFR_MEM8(0x64)
+#define PORTG _SFR_MEM8(0x65)
+#define SPMCSR _SFR_MEM8(0x68)
+#define EICRA _SFR_MEM8(0x6A)
+#define XMCRB _SFR_MEM8(0x6C)
+#define XMCRA _SFR_MEM8(0x6D)
+#define OSCCAL _SFR_MEM8(0x6F)
+#define TWBR _SFR_MEM8(0x70)
+#define TWSR _SFR_MEM8(0x71)
+#define TWAR _SFR_MEM8(0x72)
+#define TWDR _SFR_MEM8(0x73)
+#define TWCR _SFR_MEM8(0x74)
+#define OCR1C _SFR_MEM16(0x78)
+#define OCR1CL _SFR_MEM8(0x78)
+#define OCR1CH _SFR_MEM8(0x79)
+#define TCCR1C _SFR_MEM8(0x7A)
+#define ETIFR _SFR_MEM8(0x7C)
+#define ETIMSK _SFR_MEM8(0x7D)
+#define ICR3 _SFR_MEM16(0x80)
+#define ICR3L _SFR_MEM8(0x80)
+#define ICR3H _SFR_MEM8(0x81)
+#define OCR3C _SFR_MEM16(0x82)
+#define OCR3CL _SFR_MEM8(0x82)
+#define OCR3CH _SFR_MEM8(0x83)
+#define OCR3B _SFR_MEM16(0x84)
+#define OCR3BL _SFR_MEM8(0x84)
+#define OCR3BH _SFR_MEM8(0x85)
+#define OCR3A _SFR_MEM16(0x86)
+#define OCR3AL _SFR_MEM8(0x86)
+#define OCR3AH _SFR_MEM8(0x87)
+#define TCNT3 _SFR_MEM16(0x88)
+#define TCNT3L _SFR_MEM8(0x88)
+#define TCNT3H _SFR_MEM8(0x89)
+#define TCCR3B _SFR_MEM8(0x8A)
+#define TCCR3A _SFR_MEM8(0x8B)
+#define TCCR3C _SFR_MEM8(0x8C)
+#define UBRR0H _SFR_MEM8(0x90)
+#define UCSR0C _SFR_MEM8(0x95)
+#define UBRR1H _SFR_MEM8(0x98)
+#define UBRR1L _SFR_MEM8(0x99)
+#define UCSR1B _SFR_MEM8(0x9A)
+#define UCSR1A _SFR_MEM8(0x9B)
+#define UDR1 _SFR_MEM8(0x9C)
+#define UCSR1C _SFR_MEM8(0x9D)
+
+// Interrupt vectors
+#define _VECTOR(N) __vector_ ## N
+
+#define INT0_vect_num 1
+#define INT0_vect _VECTOR(1)
+#define INT1_vect_num 2
+#define INT1_vect _VECTOR(2)
+#define INT2_vect_num 3
+#define INT2_vect _VECTOR(3)
+#define INT3_vect_num 4
+#define INT3_vect _VECTOR(4)
+#define INT4_vect_num 5
+#define INT4_vect _VECTOR(5)
+#define INT5_vect_num 6
+#define INT5_vect _VECTOR(6)
+#define INT6_vect_num 7
+#define INT6_vect _VECTOR(7)
+#define INT7_vect_num 8
+#define INT7_vect _VECTOR(8)
+#define TIMER2_COMP_vect_num 9
+#define TIMER2_COMP_vect _VECTOR(9)
+#define TIMER2_OVF_vect_num 10
+#define TIMER2_OVF_vect _VECTOR(10)
+#define TIMER1_CAPT_vect_num 11
+#define TIMER1_CAPT_vect _VECTOR(11)
+#define TIMER1_COMPA_vect_num 12
+#define TIMER1_COMPA_vect _VECTOR(12)
+#define TIMER1_COMPB_vect_num 13
+#define TIMER1_COMPB_vect _VECTOR(13)
+#define TIMER1_OVF_vect_num 14
+#define TIMER1_OVF_vect _VECTOR(14)
+#define TIMER0_COMP_vect_num 15
+#define TIMER0_COMP_vect _VECTOR(15)
+#define TIMER0_OVF_vect_num 16
+#define TIMER0_OVF_vect _VECTOR(16)
+#define SPI_STC_vect_num 17
+#define SPI_STC_vect _VECTOR(17)
+#define USART0_RX_vect_num 18
+#define USART0_RX_vect _VECTOR(18)
+#define USART0_UDRE_vect_num 19
+#define USART0_UDRE_vect _VECTOR(19)
+#define USART0_TX_vect_num 20
+#define USART0_TX_vect _VECTOR(20)
+#define ADC_vect_num 21
+#define ADC_vect _VECTOR(21)
+#define EE_READY_vect_num 22
+#define EE_READY_vect _VECTOR(22)
+#define ANALOG_COMP_vect_num 23
+#define ANALOG_COMP_vect _VECTOR(23)
+#define TIMER1_COMPC_vect_num 24
+#define TIMER1_COMPC_vect _VECTOR(24)
+#define TIMER3_CAPT_vect_num 25
+#define TIMER3_CAPT_vect _VECTOR(25)
+#define TIMER3_COMPA_vect_num 26
+#define TIMER3_COMPA_vect _VECTOR(26)
+#define TIMER3_COMPB_vect_num 27
+#define TIMER3_COMPB_vect _VECTOR(27)
+#define TIMER3_COMPC_vect_num 28
+#define TIMER3_COMPC_vect _VECTOR(28)
+#define TIMER3_OVF_vect_num 29
+#define TIMER3_OVF_vect _VECTOR(29)
+#define USART1_RX_vect_num 30
+#define USART1_RX_vect _VECTOR(30)
+#define USART1_UDRE_vect_num 31
+#define USART1_UDRE_vect _VECTOR(31)
+#define USART1_TX_vect_num 32
+#define USART1_TX_vect _VECTOR(32)
+#define TWI_vect_num 33
+#define TWI_vect _VECTOR(33)
+#define SPM_READY_vect_num 34
+#define SPM_READY_vect _VECTOR(34)
+
+// ADCSRA
+#define ADEN 7
+#define ADSC 6
+#define ADFR 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+
+// ADMUX
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define MUX4 4
+#define MUX3 3
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+
+// UCSRnA
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define MPCM0 0
+#define RXC1 7
+#define TXC1 6
+#define UDRE1 5
+#define FE1 4
+#define DOR1 3
+#define UPE1 2
+#define U2X1 1
+#define MPCM1 0
+
+// UCSRnB
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ02 2
+#define RXB80 1
+#define TXB80 0
+#define RXCIE1 7
+#define TXCIE1 6
+#define UDRIE1 5
+#define RXEN1 4
+#define TXEN1 3
+#define UCSZ12 2
+#define RXB81 1
+#define TXB81 0
+
+// UCSRnC
+#define UMSEL0 6
+#define UPM01 5
+#define UPM00 4
+#define USBS0 3
+#define UCSZ01 2
+#define UCSZ00 1
+#define UCPOL0 0
+#define UMSEL1 6
+#define UPM11 5
+#define UPM10 4
+#define USBS1 3
+#define UCSZ11 2
+#define UCSZ10 1
+#define UCPOL1 0
+
+// EECR
+#define EERIE 3
+#define EEMWE 2
+#define EEWE 1
+#define EERE 0
+
+// WDTCR
+#define WDCE 4
+#define WDE 3
+#define WDP2 2
+#define WDP1 1
+#define WDP0 0
+
+// TCCR0
+#define FOC0 7
+#define WGM00 6
+#define COM01 5
+#define COM00 4
+#define WGM01 3
+#define CS02 2
+#define CS01 1
+#define CS00 0
+
+// TCCR2
+#define FOC2 7
+#define WGM20 6
+#define COM21 5
+#define COM20 4
+#define WGM21 3
+#define CS22 2
+#define CS21 1
+#define CS20 0
+
+// ASSR
+#define AS0 3
+#define TCN0UB 2
+#define OCR0UB 1
+#define TCR0UB 0
+
+// TCCR1A, TCCR3A
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define COM1C1 3
+#define COM1C0 2
+#define WGM11 1
+#define WGM10 0
+#define COM3A1 7
+#define COM3A0 6
+#define COM3B1 5
+#define COM3B0 4
+#define COM3C1 3
+#define COM3C0 2
+#define WGM31 1
+#define WGM30 0
+
+// TCCR1B, TCCR3B
+#define ICNC1 7
+#define ICES1 6
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define ICNC3 7
+#define ICES3 6
+#define WGM33 4
+#define WGM32 3
+#define CS32 2
+#define CS31 1
+#define CS30 0
+
+// TIMSK, TIFR
+#define OCIE2 7
+#define TOIE2 6
+#define TICIE1 5
+#define OCIE1A 4
+#define OCIE1B 3
+#define TOIE1 2
+#define OCIE0 1
+#define TOIE0 0
+#define OCF2 7
+#define TOV2 6
+#define ICF1 5
+#define OCF1A 4
+#define OCF1B 3
+#define TOV1 2
+#define OCF0 1
+#define TOV0 0
+
+// ETIMSK, ETIFR
+#define TICIE3 5
+#define OCIE3A 4
+#define OCIE3B 3
+#define TOIE3 2
+#define OCIE3C 1
+#define OCIE1C 0
+#define ICF3 5
+#define OCF3A 4
+#define OCF3B 3
+#define TOV3 2
+#define OCF3C 1
+#define OCF1C 0
+
+// SFIOR
+#define TSM 7
+#define ACME 3
+#define PUD 2
+#define PSR0 1
+#define PSR321 0
+
+// MCUCR
+#define SRE 7
+#define SRW10 6
+#define SE 5
+#define SM1 4
+#define SM0 3
+#define SM2 2
+#define IVSEL 1
+#define IVCE 0
+
+// EICRA
+#define ISC31 7
+#define ISC30 6
+#define ISC21 5
+#define ISC20 4
+#define ISC11 3
+#define ISC10 2
+#define ISC01 1
+#define ISC00 0
+
+// EIMSK, EIFR
+#define INT7 7
+#define INT6 6
+#define INT5 5
+#define INT4 4
+#define INT3 3
+#define INT2 2
+#define INT1 1
+#define INT0 0
+#define INTF7 7
+#define INTF6 6
+#define INTF5 5
+#define INTF4 4
+#define INTF3 3
+#define INTF2 2
+#define INTF1 1
+#define INTF0 0
+
+// SREG
+#define SREG_I 7
+
+#define RAMSTART 0x100
+#define RAMEND 0x10FF
+#define XRAMEND 0xFFFF
+#define E2END 0x0FFF
+#define E2PAGESIZE 8
+#define FLASHEND 0x1FFFF
+#define SPM_PAGESIZE 256
+
+#endif
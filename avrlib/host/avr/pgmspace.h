@@ -0,0 +1,27 @@
+#ifndef AVRLIB_HOST_AVR_PGMSPACE_H
+#define AVRLIB_HOST_AVR_PGMSPACE_H
+#define __PGMSPACE_H_ 1
+
+#include <stdint.h>
+#include <string.h>
+
+// The flash is ordinary memory on the host.
+#define PROGMEM
+#define PGM_P char const *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(uint8_t const *)(addr))
+#define pgm_read_word(addr) (*(uint16_t const *)(addr))
+#define pgm_read_dword(addr) (*(uint32_t const *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+#define pgm_read_byte_near pgm_read_byte
+#define pgm_read_word_near pgm_read_word
+#define pgm_read_byte_far pgm_read_byte
+#define pgm_read_word_far pgm_read_word
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+
+#endif
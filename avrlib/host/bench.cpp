@@ -0,0 +1,300 @@
+// Microbenchmarks of the avrlib primitives used by the main loop, built by
+// `make bench` against the host build. The inputs come from fixed seeds and
+// the results are printed as JSON lines, see bench.hpp.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "../async_usart.hpp"
+#include "../buffer.hpp"
+#include "../command_parser.hpp"
+#include "../filter.hpp"
+#include "../fixedpoint.hpp"
+#include "../format.hpp"
+#include "../make_byte.hpp"
+#include "../math.hpp"
+#include "../response_curve.hpp"
+#include "bench.hpp"
+
+using namespace avrlib;
+using avrlib::host::bench;
+using avrlib::host::bench_random;
+using avrlib::host::keep;
+
+// Takes the bytes without any register access, so that only the library
+// code is measured.
+struct sink_usart
+{
+	typedef uint8_t value_type;
+
+	sink_usart()
+		: sum(0)
+	{
+	}
+
+	bool tx_empty() const { return true; }
+	void send(value_type v) { sum += v; }
+	void dre_interrupt(uart_interrupt_priority_t) {}
+
+	uint32_t sum;
+};
+
+struct sink_stream
+{
+	sink_stream()
+		: sum(0)
+	{
+	}
+
+	void write(uint8_t v) { sum = sum * 31 + v; }
+
+	uint32_t sum;
+};
+
+static const uint16_t input_size = 1024;
+
+uint8_t bytes[input_size];
+int16_t words[input_size];
+int16_t samples[input_size];
+uint8_t commands[input_size];
+
+void make_inputs()
+{
+	bench_random rnd;
+	for (uint16_t i = 0; i != input_size; ++i)
+	{
+		uint32_t const r = rnd();
+		bytes[i] = r;
+		words[i] = r >> 8;
+		samples[i] = 512 + int16_t(r % 401) - 200;
+	}
+
+	// binary commands with 0 to 8 bytes of data mixed with simple commands
+	uint16_t i = 0;
+	while (i != input_size)
+	{
+		uint32_t const r = rnd();
+		uint8_t const size = r % 9;
+		if (r & 0x100)
+		{
+			commands[i++] = 'a' + (r >> 16) % 26;
+			continue;
+		}
+		if (uint16_t(input_size - i) < size + 2)
+		{
+			commands[i++] = '?';
+			continue;
+		}
+		commands[i++] = 0x80;
+		commands[i++] = (((r >> 12) & 0x0f) << 4) | size;
+		for (uint8_t j = 0; j != size; ++j)
+			commands[i++] = rnd();
+	}
+}
+
+void bench_buffer_pow2(uint32_t ops)
+{
+	buffer<uint8_t, 32> buf;
+	uint8_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		buf.push(bytes[i % input_size]);
+		uint8_t v = 0;
+		buf.try_pop(v);
+		sum += v;
+	}
+	keep(sum);
+}
+
+void bench_buffer_npot(uint32_t ops)
+{
+	buffer<uint8_t, 48> buf;
+	uint8_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		buf.push(bytes[i % input_size]);
+		uint8_t v = 0;
+		buf.try_pop(v);
+		sum += v;
+	}
+	keep(sum);
+}
+
+// The byte is queued and then taken by the data register empty handler.
+void bench_async_usart_write(uint32_t ops)
+{
+	async_usart<sink_usart, 16, 64> usart;
+	usart.async_tx(true);
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		usart.write(bytes[i % input_size]);
+		usart.intr_tx();
+	}
+	keep(usart.usart().sum);
+}
+
+// A burst of 48 bytes, as for a text frame, then the handler drains it.
+void bench_async_usart_burst(uint32_t ops)
+{
+	async_usart<sink_usart, 16, 64> usart;
+	usart.async_tx(true);
+	for (uint32_t i = 0; i < ops; i += 48)
+	{
+		for (uint8_t j = 0; j != 48; ++j)
+			usart.write(bytes[(i + j) % input_size]);
+		while (usart.intr_tx())
+		{
+		}
+	}
+	keep(usart.usart().sum);
+}
+
+void bench_send_int(uint32_t ops)
+{
+	sink_stream s;
+	for (uint32_t i = 0; i != ops; ++i)
+		send_int(s, words[i % input_size], 7);
+	keep(s.sum);
+}
+
+void bench_send_hex(uint32_t ops)
+{
+	sink_stream s;
+	for (uint32_t i = 0; i != ops; ++i)
+		send_hex(s, uint16_t(words[i % input_size]), 4);
+	keep(s.sum);
+}
+
+// One operation is a whole pattern with three arguments.
+void bench_format(uint32_t ops)
+{
+	sink_stream s;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		uint16_t const k = i % input_size;
+		format(s, "axis %: % (%)\n") % bytes[k] % words[k] % samples[k];
+	}
+	keep(s.sum);
+}
+
+void bench_command_parser(uint32_t ops)
+{
+	command_parser parser;
+	parser.clear();
+	uint8_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		uint8_t const r = parser.push_data(commands[i % input_size]);
+		if (r == 254)
+			parser.clear();
+		sum += r;
+	}
+	keep(sum);
+}
+
+struct bench_shape
+{
+	int16_t operator()(int32_t x) const
+	{
+		int32_t const d = (x - 512) * 64;
+		int32_t a = d < 0? -d: d;
+		a = (a + ((a * a >> 15) * a >> 15)) / 2;
+		return d < 0? -a: a;
+	}
+};
+
+// The filter and the curve that took over from get_pot(): one operation is
+// one sample, every fourth of them also goes through the curve.
+void bench_axis(uint32_t ops)
+{
+	oversampled_filter<4, iir_filter<int16_t, 2> > filter;
+	response_curve<8> curve;
+	curve.build(12, 500, 524, 1012, bench_shape());
+
+	int32_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		if (filter.add(samples[i % input_size]))
+			sum += curve(filter.value());
+	}
+	keep(sum);
+}
+
+// The conversion the curves replaced: the deviation from the offset times
+// an integer gain picked by its sign, clamped. One operation is one sample.
+void bench_get_pot(uint32_t ops)
+{
+	int16_t const offset = 512;
+	int16_t const gain_neg = 64;
+	int16_t const gain_pos = 65;
+
+	int32_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		int32_t v = int16_t(samples[i % input_size] - offset);
+		v *= v < 0? gain_neg: gain_pos;
+		sum += clamp(v, -32767, 32767);
+	}
+	keep(sum);
+}
+
+// The calibration of the curves: the same deviation times an 8.8 gain,
+// rounded and saturated by mul_sat(), against the integer gain above
+void bench_calibration_q8_8(uint32_t ops)
+{
+	int16_t const offset = 512;
+	fixedpoint<uint16_t, 8> const gain_neg = full_scale_gain<uint16_t, 8>(512);
+	fixedpoint<uint16_t, 8> const gain_pos = full_scale_gain<uint16_t, 8>(511);
+
+	int32_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		int16_t const d = samples[i % input_size] - offset;
+		sum += mul_sat(d, d < 0? gain_neg: gain_pos);
+	}
+	keep(sum);
+}
+
+// The curve alone, one sample per operation, for the comparison with
+// get_pot()
+void bench_axis_curve(uint32_t ops)
+{
+	response_curve<8> curve;
+	curve.build(12, 500, 524, 1012, bench_shape());
+
+	int32_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+		sum += curve(samples[i % input_size]);
+	keep(sum);
+}
+
+void bench_make_byte(uint32_t ops)
+{
+	uint8_t sum = 0;
+	for (uint32_t i = 0; i != ops; ++i)
+	{
+		uint8_t const b = bytes[i % input_size];
+		sum += make_byte(b & 0x01, b & 0x02, b & 0x04, b & 0x08, b & 0x10, b & 0x20, b & 0x40, b & 0x80);
+	}
+	keep(sum);
+}
+
+int main()
+{
+	make_inputs();
+
+	bench("buffer_push_pop", &bench_buffer_pow2);
+	bench("buffer_push_pop_npot", &bench_buffer_npot);
+	bench("async_usart_write", &bench_async_usart_write);
+	bench("async_usart_burst", &bench_async_usart_burst);
+	bench("send_int", &bench_send_int);
+	bench("send_hex", &bench_send_hex);
+	bench("format", &bench_format);
+	bench("command_parser", &bench_command_parser);
+	bench("get_pot_legacy", &bench_get_pot);
+	bench("calibration_q8_8", &bench_calibration_q8_8);
+	bench("axis_curve", &bench_axis_curve);
+	bench("axis_filter_curve", &bench_axis);
+	bench("make_byte", &bench_make_byte);
+	return 0;
+}
@@ -0,0 +1,160 @@
+#ifndef AVRLIB_HOST_BENCH_HPP
+#define AVRLIB_HOST_BENCH_HPP
+
+// Microbenchmarks of the host build.
+//
+// Each benchmark is a function taking the number of operations to run. The
+// count is doubled until a run takes bench_min_time, then bench_samples runs
+// of that size are timed and the median is reported. The instructions are
+// counted by perf_event_open() if the kernel allows it; the smallest count of
+// the samples is reported. The results are printed as JSON lines:
+//
+//   {"name":"buffer_push_pop","ops":4194304,"ns_per_op":1.92,"instructions_per_op":11.0}
+//
+// instructions_per_op is null where the counters are unavailable.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace avrlib {
+namespace host {
+
+static const uint8_t bench_samples = 5;
+static const int64_t bench_min_time = 20000000; // ns
+
+// Keeps the compiler from dropping the computation of v.
+template <typename T>
+inline void keep(T const & v)
+{
+	asm volatile ("" : : "g"(&v) : "memory");
+}
+
+// xorshift32, so that the inputs are the same in every run
+class bench_random
+{
+public:
+	explicit bench_random(uint32_t seed = 2463534242u)
+		: m_state(seed)
+	{
+	}
+
+	uint32_t operator()()
+	{
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+private:
+	uint32_t m_state;
+};
+
+class instruction_counter
+{
+public:
+	instruction_counter()
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof attr;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		m_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	~instruction_counter()
+	{
+		if (m_fd >= 0)
+			close(m_fd);
+	}
+
+	bool available() const { return m_fd >= 0; }
+
+	void start()
+	{
+		if (m_fd < 0)
+			return;
+		ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	uint64_t stop()
+	{
+		uint64_t res = 0;
+		if (m_fd < 0)
+			return res;
+		ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(m_fd, &res, sizeof res) != sizeof res)
+			res = 0;
+		return res;
+	}
+
+private:
+	int m_fd;
+};
+
+inline int64_t bench_now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+template <typename F>
+void bench(char const * name, F f)
+{
+	static instruction_counter counter;
+
+	uint32_t ops = 1024;
+	for (;;)
+	{
+		int64_t const start = bench_now();
+		f(ops);
+		if (bench_now() - start >= bench_min_time || ops >= (1u << 30))
+			break;
+		ops *= 2;
+	}
+
+	int64_t times[bench_samples];
+	uint64_t instructions = 0;
+	for (uint8_t i = 0; i != bench_samples; ++i)
+	{
+		counter.start();
+		int64_t const start = bench_now();
+		f(ops);
+		times[i] = bench_now() - start;
+		uint64_t const n = counter.stop();
+		if (i == 0 || n < instructions)
+			instructions = n;
+
+		for (uint8_t j = i; j != 0 && times[j] < times[j - 1]; --j)
+		{
+			int64_t const t = times[j];
+			times[j] = times[j - 1];
+			times[j - 1] = t;
+		}
+	}
+
+	printf("{\"name\":\"%s\",\"ops\":%u,\"ns_per_op\":%.3f,\"instructions_per_op\":", name, ops,
+		double(times[bench_samples / 2]) / ops);
+	if (counter.available() && instructions != 0)
+		printf("%.2f}\n", double(instructions) / ops);
+	else
+		printf("null}\n");
+	fflush(stdout);
+}
+
+}
+}
+
+#endif
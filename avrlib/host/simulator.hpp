@@ -0,0 +1,1252 @@
+#ifndef AVRLIB_HOST_SIMULATOR_HPP
+#define AVRLIB_HOST_SIMULATOR_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#ifndef F_CPU
+# error F_CPU must be defined for the host build.
+#endif
+
+namespace avrlib {
+namespace host {
+
+// ATmega128 running as a Linux process.
+//
+// The registers of avr/io.h are backed by the I/O space of a single
+// machine and every access costs io_access_cycles. Time passes with
+// the register accesses, sei(), the sleep and the delays; the code between
+// them is free. The peripherals are advanced along and the pending
+// interrupts are dispatched in the order of their vectors whenever the I
+// flag is set, so the firmware runs unmodified, deterministically and as
+// fast as the host allows.
+//
+// A loop that only polls the memory, e.g. a volatile flag set by a
+// handler, never enters the model. A timer signal catches it: when the
+// firmware has not entered the model for a whole spin_period with the
+// interrupts enabled, the signal handler lets the time pass up to the
+// next interrupt, at most spin_quantum, and takes it, as the spinning CPU
+// would. The loop sees one interrupt per period, so its end depends on
+// the host only if it does more than poll.
+//
+// Modelled are the GPIO ports with external levels and pull-ups, timer0,
+// timer2 and, on the prescaler they share with it, timer1 and timer3 in
+// their single-slope modes, both USARTs with the frame
+// time given by UBRR and U2X, the ADC with injectable samples, the EEPROM
+// with its write latency, INT2 on the falling edges of the frames received
+// by USART1, the sleep modes and the watchdog reset, which ends the process. The accesses
+// the EEPROM would ignore or corrupt during a write are counted in
+// machine::eeprom_errors.
+//
+// The process is configured through the environment:
+//
+//   AVRLIB_HOST_EEPROM    file holding the EEPROM, loaded at the start and
+//                         saved at the end
+//   AVRLIB_HOST_TIME      simulated seconds after which the process ends
+//   AVRLIB_HOST_LINGER    simulated milliseconds the process runs on after
+//                         the end of the standard input, 1000 by default,
+//                         negative to run on
+//   AVRLIB_HOST_REALTIME  1 to pace the simulation to the wall clock, the
+//                         default if the standard input is a terminal
+//   AVRLIB_HOST_ADC       comma-separated 10-bit samples of the channels
+//                         0 to 7, 512 by default
+//   AVRLIB_HOST_PINA..G   levels driven onto the input pins of a port
+//
+// USART1 reads the standard input and writes the standard output, the
+// output of USART0 is discarded. A harness including the firmware can
+// replace them and the ADC samples through the functions below.
+
+typedef uint64_t cycle_t;
+typedef void (*isr_t)();
+
+static const uint8_t vector_count = 35;
+static const uint16_t eeprom_size = 4096;
+static const cycle_t io_access_cycles = 2;
+
+// Longest step the peripherals are advanced by at once
+static const cycle_t max_step = 32;
+
+// Wall time of the spin check and the longest wait for an interrupt it
+// lets pass
+static const long spin_period_us = 200;
+static const cycle_t spin_quantum = F_CPU / 1000;
+
+// 8.5ms of the EEPROM write
+static const cycle_t eeprom_write_cycles = F_CPU / 2000 * 17;
+
+enum exit_code
+{
+	exit_ok = 0,
+	exit_bad_interrupt = 1,
+	exit_reset = 2
+};
+
+// Data memory addresses of the registers with side effects
+enum io_address
+{
+	io_pinf = 0x20, io_pine = 0x21, io_ddre = 0x22, io_porte = 0x23,
+	io_adcl = 0x24, io_adch = 0x25, io_adcsra = 0x26, io_admux = 0x27,
+	io_ubrr0l = 0x29, io_ucsr0b = 0x2A, io_ucsr0a = 0x2B, io_udr0 = 0x2C,
+	io_pind = 0x30, io_ddrd = 0x31, io_portd = 0x32,
+	io_pinc = 0x33, io_ddrc = 0x34, io_portc = 0x35,
+	io_pinb = 0x36, io_ddrb = 0x37, io_portb = 0x38,
+	io_pina = 0x39, io_ddra = 0x3A, io_porta = 0x3B,
+	io_eecr = 0x3C, io_eedr = 0x3D, io_earl = 0x3E, io_earh = 0x3F,
+	io_sfior = 0x40, io_wdtcr = 0x41, io_ocr2 = 0x43, io_tcnt2 = 0x44, io_tccr2 = 0x45,
+	io_icr1l = 0x46, io_ocr1bl = 0x48, io_ocr1al = 0x4A, io_tcnt1l = 0x4C,
+	io_tccr1b = 0x4E, io_tccr1a = 0x4F,
+	io_ocr0 = 0x51, io_tcnt0 = 0x52, io_tccr0 = 0x53,
+	io_mcucr = 0x55, io_tifr = 0x56, io_timsk = 0x57, io_eifr = 0x58, io_eimsk = 0x59,
+	io_sreg = 0x5F,
+	io_ddrf = 0x61, io_portf = 0x62, io_ping = 0x63, io_ddrg = 0x64, io_portg = 0x65,
+	io_eicra = 0x6A,
+	io_ocr1cl = 0x78, io_etifr = 0x7C, io_etimsk = 0x7D,
+	io_icr3l = 0x80, io_ocr3cl = 0x82, io_ocr3bl = 0x84, io_ocr3al = 0x86, io_tcnt3l = 0x88,
+	io_tccr3b = 0x8A, io_tccr3a = 0x8B,
+	io_ubrr0h = 0x90, io_ubrr1h = 0x98, io_ubrr1l = 0x99,
+	io_ucsr1b = 0x9A, io_ucsr1a = 0x9B, io_udr1 = 0x9C
+};
+
+struct port_regs
+{
+	uint8_t pin;
+	uint8_t ddr;
+	uint8_t port;
+};
+
+static port_regs const ports[] = {
+	{ io_pina, io_ddra, io_porta },
+	{ io_pinb, io_ddrb, io_portb },
+	{ io_pinc, io_ddrc, io_portc },
+	{ io_pind, io_ddrd, io_portd },
+	{ io_pine, io_ddre, io_porte },
+	{ io_pinf, io_ddrf, io_portf },
+	{ io_ping, io_ddrg, io_portg }
+};
+
+static const uint8_t port_count = sizeof ports / sizeof ports[0];
+
+struct usart_regs
+{
+	uint8_t udr;
+	uint8_t ucsra;
+	uint8_t ucsrb;
+	uint8_t ubrrl;
+	uint8_t ubrrh;
+};
+
+static usart_regs const usarts[] = {
+	{ io_udr0, io_ucsr0a, io_ucsr0b, io_ubrr0l, io_ubrr0h },
+	{ io_udr1, io_ucsr1a, io_ucsr1b, io_ubrr1l, io_ubrr1h }
+};
+
+// UCSRnA and UCSRnB bits
+enum
+{
+	usart_rxc = (1<<7), usart_txc = (1<<6), usart_udre = (1<<5), usart_dor = (1<<3), usart_u2x = (1<<1),
+	usart_rxen = (1<<4), usart_txen = (1<<3)
+};
+
+struct timer8_regs
+{
+	uint8_t tccr;
+	uint8_t tcnt;
+	uint8_t ocr;
+	uint8_t tov;    // in TIFR
+	uint8_t ocf;
+};
+
+static timer8_regs const timers8[] = {
+	{ io_tccr0, io_tcnt0, io_ocr0, (1<<0), (1<<1) },
+	{ io_tccr2, io_tcnt2, io_ocr2, (1<<6), (1<<7) }
+};
+
+struct timer16_regs
+{
+	uint8_t tccra;
+	uint8_t tccrb;
+	uint8_t tcnt;
+	uint8_t ocra;
+	uint8_t ocrb;
+	uint8_t ocrc;
+	uint8_t icr;
+	uint8_t tifr;   // holds the flags below but OCFnC
+	uint8_t ocfc_reg;
+	uint8_t ocfc;
+};
+
+// ICFn, OCFnA, OCFnB and TOVn are at the same bits for both timers
+enum { timer16_icf = (1<<5), timer16_ocfa = (1<<4), timer16_ocfb = (1<<3), timer16_tov = (1<<2) };
+
+static timer16_regs const timers16[] = {
+	{ io_tccr1a, io_tccr1b, io_tcnt1l, io_ocr1al, io_ocr1bl, io_ocr1cl, io_icr1l, io_tifr, io_etifr, (1<<0) },
+	{ io_tccr3a, io_tccr3b, io_tcnt3l, io_ocr3al, io_ocr3bl, io_ocr3cl, io_icr3l, io_etifr, io_etifr, (1<<1) }
+};
+
+enum vector_kind
+{
+	vector_flag,      // the flag is cleared when the vector is taken
+	vector_level,     // the flag is cleared by the handler
+	vector_level_inv  // pending while the flag is clear
+};
+
+struct vector_source
+{
+	uint8_t vector;
+	uint8_t kind;
+	uint8_t mask_reg;
+	uint8_t mask;
+	uint8_t flag_reg;
+	uint8_t flag;
+};
+
+// In the order of priority
+static vector_source const vector_sources[] = {
+	{  1, vector_flag,      io_eimsk,  (1<<0), io_eifr,   (1<<0) },
+	{  2, vector_flag,      io_eimsk,  (1<<1), io_eifr,   (1<<1) },
+	{  3, vector_flag,      io_eimsk,  (1<<2), io_eifr,   (1<<2) },
+	{  4, vector_flag,      io_eimsk,  (1<<3), io_eifr,   (1<<3) },
+	{  5, vector_flag,      io_eimsk,  (1<<4), io_eifr,   (1<<4) },
+	{  6, vector_flag,      io_eimsk,  (1<<5), io_eifr,   (1<<5) },
+	{  7, vector_flag,      io_eimsk,  (1<<6), io_eifr,   (1<<6) },
+	{  8, vector_flag,      io_eimsk,  (1<<7), io_eifr,   (1<<7) },
+	{  9, vector_flag,      io_timsk,  (1<<7), io_tifr,   (1<<7) },
+	{ 10, vector_flag,      io_timsk,  (1<<6), io_tifr,   (1<<6) },
+	{ 11, vector_flag,      io_timsk,  (1<<5), io_tifr,   (1<<5) },
+	{ 12, vector_flag,      io_timsk,  (1<<4), io_tifr,   (1<<4) },
+	{ 13, vector_flag,      io_timsk,  (1<<3), io_tifr,   (1<<3) },
+	{ 14, vector_flag,      io_timsk,  (1<<2), io_tifr,   (1<<2) },
+	{ 15, vector_flag,      io_timsk,  (1<<1), io_tifr,   (1<<1) },
+	{ 16, vector_flag,      io_timsk,  (1<<0), io_tifr,   (1<<0) },
+	{ 18, vector_level,     io_ucsr0b, (1<<7), io_ucsr0a, usart_rxc },
+	{ 19, vector_level,     io_ucsr0b, (1<<5), io_ucsr0a, usart_udre },
+	{ 20, vector_flag,      io_ucsr0b, (1<<6), io_ucsr0a, usart_txc },
+	{ 21, vector_flag,      io_adcsra, (1<<3), io_adcsra, (1<<4) },
+	{ 22, vector_level_inv, io_eecr,   (1<<3), io_eecr,   (1<<1) },
+	{ 24, vector_flag,      io_etimsk, (1<<0), io_etifr,  (1<<0) },
+	{ 25, vector_flag,      io_etimsk, (1<<5), io_etifr,  (1<<5) },
+	{ 26, vector_flag,      io_etimsk, (1<<4), io_etifr,  (1<<4) },
+	{ 27, vector_flag,      io_etimsk, (1<<3), io_etifr,  (1<<3) },
+	{ 28, vector_flag,      io_etimsk, (1<<1), io_etifr,  (1<<1) },
+	{ 29, vector_flag,      io_etimsk, (1<<2), io_etifr,  (1<<2) },
+	{ 30, vector_level,     io_ucsr1b, (1<<7), io_ucsr1a, usart_rxc },
+	{ 31, vector_level,     io_ucsr1b, (1<<5), io_ucsr1a, usart_udre },
+	{ 32, vector_flag,      io_ucsr1b, (1<<6), io_ucsr1a, usart_txc }
+};
+
+static const uint8_t vector_source_count = sizeof vector_sources / sizeof vector_sources[0];
+
+// The vectors of the external interrupts, the ADC and the EEPROM, which
+// wake the CPU up from the sleep modes other than idle.
+inline bool wakes_from_deep_sleep(uint8_t vector)
+{
+	return vector <= 8 || vector == 21 || vector == 22;
+}
+
+struct usart_state
+{
+	int (*rx)();            // the next byte of the line or -1
+	void (*tx)(uint8_t v);
+
+	bool tx_shifting;
+	bool tx_buffered;
+	uint8_t tx_shift;
+	uint8_t tx_buffer;
+	cycle_t tx_end;
+
+	bool rx_shifting;
+	uint8_t rx_shift;
+	uint8_t rx_bit;         // the next bit of the frame on the line
+	cycle_t rx_start;
+	uint8_t rx_fifo[2];
+	uint8_t rx_count;
+	cycle_t rx_end;
+	cycle_t rx_poll;
+
+	uint32_t sent;
+	uint32_t received;
+};
+
+struct machine
+{
+	bool ready;
+	bool halted;
+	bool realtime;
+	bool timers_halted;
+
+	// Nesting of the calls into the model, which the spin handler must not
+	// interrupt
+	volatile sig_atomic_t depth;
+	cycle_t spin_mark;
+	uint32_t spin_wakes;
+
+	uint8_t io[0x100];
+	cycle_t now;
+	cycle_t limit;          // 0 for none
+	cycle_t linger;
+	bool linger_forever;
+
+	isr_t vectors[vector_count];
+	uint32_t interrupts;
+	uint32_t vector_interrupts[vector_count];
+	cycle_t sleep_cycles;
+
+	uint8_t drive_mask[port_count];
+	uint8_t drive_level[port_count];
+
+	uint16_t timer0_prescaler;
+	uint16_t prescaler321;  // shared by timers 1, 2 and 3
+	uint8_t timer_temp[2];
+
+	usart_state usart[2];
+
+	bool adc_busy;
+	bool adc_first;
+	cycle_t adc_end;
+	cycle_t adc_awake;      // of the running conversion
+	uint16_t adc_inputs[8];
+	uint16_t (*adc_source)(uint8_t channel);
+	uint32_t adc_conversions;
+
+	uint8_t eeprom[eeprom_size];
+	char const * eeprom_path;
+	bool eeprom_busy;
+	uint16_t eeprom_address;
+	uint8_t eeprom_value;
+	cycle_t eeprom_end;
+	cycle_t eeprom_mwe_end;
+	uint32_t eeprom_writes;
+	uint32_t eeprom_errors;
+
+	uint8_t in_buf[256];
+	uint16_t in_pos;
+	uint16_t in_len;
+	bool in_eof;
+	cycle_t in_eof_time;
+
+	cycle_t next_sync;
+	struct timespec wall_start;
+};
+
+inline void init(machine & m);
+
+inline machine & mcu()
+{
+	static machine m;
+	if (!m.ready)
+		init(m);
+	return m;
+}
+
+// The barriers make the caller reload what the spin handler may have
+// changed, as in model_scope below.
+inline uint8_t & io(uint8_t address)
+{
+	asm volatile ("" : : : "memory");
+	return mcu().io[address];
+}
+
+inline cycle_t cycles()
+{
+	asm volatile ("" : : : "memory");
+	return mcu().now;
+}
+
+inline void shutdown()
+{
+	machine & m = mcu();
+	if (m.halted)
+		return;
+	m.halted = true;
+	fflush(stdout);
+
+	if (m.eeprom_path)
+	{
+		if (FILE * f = fopen(m.eeprom_path, "wb"))
+		{
+			fwrite(m.eeprom, 1, eeprom_size, f);
+			fclose(f);
+		}
+	}
+}
+
+// Ends the process the way the chip would stop, without the destructors.
+inline void halt(exit_code code, char const * reason = 0)
+{
+	shutdown();
+	if (reason)
+		fprintf(stderr, "avrlib host: %s after %.6fs\n", reason, double(mcu().now) / F_CPU);
+	fflush(stderr);
+	_Exit(code);
+}
+
+inline int stdin_rx()
+{
+	machine & m = mcu();
+	if (m.in_pos == m.in_len)
+	{
+		if (m.in_eof)
+			return -1;
+
+		struct pollfd p = { 0, POLLIN, 0 };
+		if (poll(&p, 1, 0) <= 0)
+			return -1;
+
+		ssize_t const len = read(0, m.in_buf, sizeof m.in_buf);
+		if (len <= 0)
+		{
+			m.in_eof = true;
+			m.in_eof_time = m.now;
+			return -1;
+		}
+		m.in_pos = 0;
+		m.in_len = len;
+	}
+	return m.in_buf[m.in_pos++];
+}
+
+inline void stdout_tx(uint8_t v)
+{
+	putchar(v);
+}
+
+inline void discard_tx(uint8_t)
+{
+}
+
+// Port 0 is PORTA. The driven pins read the level unless they are outputs,
+// the others read their pull-ups.
+inline void drive(uint8_t port, uint8_t mask, uint8_t level)
+{
+	machine & m = mcu();
+	m.drive_mask[port] = mask;
+	m.drive_level[port] = level & mask;
+}
+
+inline void adc_input(uint8_t channel, uint16_t value)
+{
+	mcu().adc_inputs[channel & 7] = value & 0x3ff;
+}
+
+// Replaces adc_input(); called at the end of each conversion.
+inline void adc_source(uint16_t (*source)(uint8_t channel))
+{
+	mcu().adc_source = source;
+}
+
+// The cycles of the conversion ending, when called from the source, the
+// CPU was not in a sleep that halts the I/O clock, i.e. running its
+// digital noise into the samples. The model adds none itself.
+inline cycle_t adc_awake_cycles()
+{
+	return mcu().adc_awake;
+}
+
+inline void usart_attach(uint8_t n, int (*rx)(), void (*tx)(uint8_t v))
+{
+	usart_state & u = mcu().usart[n];
+	u.rx = rx;
+	u.tx = tx != 0? tx: &discard_tx;
+}
+
+inline uint8_t * eeprom()
+{
+	return mcu().eeprom;
+}
+
+inline uint32_t usart_frame_cycles(machine & m, uint8_t n)
+{
+	usart_regs const & r = usarts[n];
+	uint16_t const ubrr = ((m.io[r.ubrrh] & 0x0f) << 8) | m.io[r.ubrrl];
+	return 10 * ((m.io[r.ucsra] & usart_u2x)? 8: 16) * (ubrr + 1UL);
+}
+
+// The level of RXD in the bit i of the frame shifting in: the start bit,
+// the data bits from the LSB and the stop bit.
+inline bool rx_level(usart_state const & u, uint8_t i)
+{
+	return i == 0? false: i == 9? true: ((u.rx_shift >> (i - 1)) & 1) != 0;
+}
+
+// RXD1 is INT2, which sees every falling edge of the frame, not only the
+// start bit.
+inline void rx_edges(machine & m, uint8_t n)
+{
+	usart_state & u = m.usart[n];
+	if (n != 1)
+		return;
+	uint32_t const bit = usart_frame_cycles(m, n) / 10;
+	for (; u.rx_bit != 10 && m.now >= u.rx_start + u.rx_bit * bit; ++u.rx_bit)
+	{
+		if ((u.rx_bit == 0 || rx_level(u, u.rx_bit - 1)) && !rx_level(u, u.rx_bit))
+			m.io[io_eifr] |= (1<<2);
+	}
+}
+
+inline void usart_step(machine & m, uint8_t n)
+{
+	usart_regs const & r = usarts[n];
+	usart_state & u = m.usart[n];
+
+	if (u.tx_shifting && m.now >= u.tx_end)
+	{
+		u.tx(u.tx_shift);
+		++u.sent;
+		if (u.tx_buffered)
+		{
+			u.tx_shift = u.tx_buffer;
+			u.tx_buffered = false;
+			u.tx_end += usart_frame_cycles(m, n);
+			m.io[r.ucsra] |= usart_udre;
+		}
+		else
+		{
+			u.tx_shifting = false;
+			m.io[r.ucsra] |= usart_txc;
+		}
+	}
+
+	if (u.rx_shifting)
+	{
+		rx_edges(m, n);
+		if (m.now < u.rx_end)
+			return;
+		u.rx_shifting = false;
+		if (u.rx_count == 2)
+		{
+			m.io[r.ucsra] |= usart_dor;
+		}
+		else
+		{
+			u.rx_fifo[u.rx_count++] = u.rx_shift;
+			m.io[r.ucsra] |= usart_rxc;
+		}
+		++u.received;
+	}
+	else if ((m.io[r.ucsrb] & usart_rxen) != 0 && m.now >= u.rx_poll && u.rx != 0)
+	{
+		int const v = u.rx();
+		uint32_t const frame = usart_frame_cycles(m, n);
+		if (v < 0)
+		{
+			u.rx_poll = m.now + frame;
+			return;
+		}
+		u.rx_shifting = true;
+		u.rx_shift = v;
+		u.rx_bit = 0;
+		u.rx_start = m.now;
+		u.rx_end = m.now + frame;
+		rx_edges(m, n);
+	}
+}
+
+inline void usart_write_udr(machine & m, uint8_t n, uint8_t v)
+{
+	usart_regs const & r = usarts[n];
+	usart_state & u = m.usart[n];
+	if ((m.io[r.ucsrb] & usart_txen) == 0)
+		return;
+
+	if (!u.tx_shifting)
+	{
+		u.tx_shifting = true;
+		u.tx_shift = v;
+		u.tx_end = m.now + usart_frame_cycles(m, n);
+	}
+	else if (!u.tx_buffered)
+	{
+		u.tx_buffered = true;
+		u.tx_buffer = v;
+		m.io[r.ucsra] &= ~usart_udre;
+	}
+}
+
+inline uint8_t usart_read_udr(machine & m, uint8_t n)
+{
+	usart_regs const & r = usarts[n];
+	usart_state & u = m.usart[n];
+	if (u.rx_count == 0)
+		return m.io[r.udr];
+
+	uint8_t const v = u.rx_fifo[0];
+	u.rx_fifo[0] = u.rx_fifo[1];
+	if (--u.rx_count == 0)
+		m.io[r.ucsra] &= ~(usart_rxc | usart_dor);
+	m.io[r.udr] = v;
+	return v;
+}
+
+inline void timer8_tick(machine & m, timer8_regs const & r)
+{
+	uint8_t const tccr = m.io[r.tccr];
+	bool const ctc = (tccr & (1<<3)) != 0 && (tccr & (1<<6)) == 0;
+	uint8_t const top = ctc? m.io[r.ocr]: 0xff;
+
+	uint8_t t = m.io[r.tcnt];
+	if (t == top || t == 0xff)
+	{
+		if (!ctc || t == 0xff)
+			m.io[io_tifr] |= r.tov;
+		t = 0;
+	}
+	else
+	{
+		++t;
+	}
+	m.io[r.tcnt] = t;
+	if (t == m.io[r.ocr])
+		m.io[io_tifr] |= r.ocf;
+}
+
+inline uint16_t io16(machine & m, uint8_t address)
+{
+	return m.io[address] | (m.io[address + 1] << 8);
+}
+
+inline void timer16_tick(machine & m, timer16_regs const & r)
+{
+	uint8_t const wgm = ((m.io[r.tccrb] >> 1) & 0x0c) | (m.io[r.tccra] & 0x03);
+	bool const ctc = wgm == 4 || wgm == 12;
+
+	uint16_t top;
+	switch (wgm)
+	{
+	case 0: top = 0xffff; break;
+	case 1: case 5: top = 0x00ff; break;
+	case 2: case 6: top = 0x01ff; break;
+	case 3: case 7: top = 0x03ff; break;
+	case 4: case 9: case 11: case 15: top = io16(m, r.ocra); break;
+	default: top = io16(m, r.icr); break;
+	}
+
+	uint16_t t = io16(m, r.tcnt);
+	if (t == top || t == 0xffff)
+	{
+		if (!ctc || t == 0xffff)
+			m.io[r.tifr] |= timer16_tov;
+		t = 0;
+	}
+	else
+	{
+		++t;
+	}
+	m.io[r.tcnt] = t;
+	m.io[r.tcnt + 1] = t >> 8;
+
+	if (t == io16(m, r.ocra))
+		m.io[r.tifr] |= timer16_ocfa;
+	if (t == io16(m, r.ocrb))
+		m.io[r.tifr] |= timer16_ocfb;
+	if (t == io16(m, r.ocrc))
+		m.io[r.ocfc_reg] |= r.ocfc;
+}
+
+inline void timers_step(machine & m, cycle_t n)
+{
+	static uint16_t const timer0_div[] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+	static uint16_t const prescaler321_div[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+
+	if (m.timers_halted)
+		return;
+
+	if (uint16_t const div = timer0_div[m.io[io_tccr0] & 0x07])
+	{
+		m.timer0_prescaler += n;
+		for (; m.timer0_prescaler >= div; m.timer0_prescaler -= div)
+			timer8_tick(m, timers8[0]);
+	}
+
+	// The timers count the taps of the prescaler they pass, so that they
+	// keep their phase to each other.
+	uint32_t const p = m.prescaler321;
+	uint32_t const q = p + n;
+	if (uint16_t const div = prescaler321_div[m.io[io_tccr2] & 0x07])
+	{
+		for (uint32_t i = q / div - p / div; i != 0; --i)
+			timer8_tick(m, timers8[1]);
+	}
+	for (uint8_t i = 0; i != 2; ++i)
+	{
+		timer16_regs const & r = timers16[i];
+		uint16_t const div = prescaler321_div[m.io[r.tccrb] & 0x07];
+		if (div == 0)
+			continue;
+		for (uint32_t j = q / div - p / div; j != 0; --j)
+			timer16_tick(m, r);
+	}
+	m.prescaler321 = q % 1024;
+}
+
+inline cycle_t adc_conversion_cycles(machine & m)
+{
+	uint8_t const adps = m.io[io_adcsra] & 0x07;
+	return (m.adc_first? 25: 13) << (adps == 0? 1: adps);
+}
+
+inline void adc_start(machine & m)
+{
+	m.adc_busy = true;
+	m.adc_end = m.now + adc_conversion_cycles(m);
+	m.adc_awake = 0;
+	m.io[io_adcsra] |= (1<<6);
+}
+
+inline void adc_step(machine & m)
+{
+	if (!m.adc_busy || m.now < m.adc_end)
+		return;
+
+	uint8_t const mux = m.io[io_admux];
+	uint8_t const channel = mux & 0x1f;
+	uint16_t v;
+	if (channel < 8)
+		v = (m.adc_source? m.adc_source(channel): m.adc_inputs[channel]) & 0x3ff;
+	else if (channel == 0x1e)
+		v = 252; // 1.23V bandgap against 5V
+	else
+		v = 0;
+	if (mux & (1<<5))
+		v <<= 6;
+
+	m.io[io_adcl] = v;
+	m.io[io_adch] = v >> 8;
+	m.io[io_adcsra] = (m.io[io_adcsra] & ~(1<<6)) | (1<<4);
+	m.adc_busy = false;
+	m.adc_first = false;
+	++m.adc_conversions;
+
+	// free running
+	if (m.io[io_adcsra] & (1<<5))
+		adc_start(m);
+}
+
+inline void adc_write_adcsra(machine & m, uint8_t v)
+{
+	uint8_t const old = m.io[io_adcsra];
+	uint8_t res = (v & ~((1<<6)|(1<<4))) | (old & (1<<4));
+	if (v & (1<<4))
+		res &= ~(1<<4);
+	if ((old & (1<<7)) == 0)
+		m.adc_first = true;
+	m.io[io_adcsra] = res;
+
+	if ((res & (1<<7)) == 0)
+	{
+		m.adc_busy = false;
+		return;
+	}
+	if (m.adc_busy)
+		m.io[io_adcsra] |= (1<<6);
+	else if (v & (1<<6))
+		adc_start(m);
+}
+
+inline void eeprom_step(machine & m)
+{
+	if ((m.io[io_eecr] & (1<<2)) != 0 && m.now >= m.eeprom_mwe_end)
+		m.io[io_eecr] &= ~(1<<2);
+
+	if (m.eeprom_busy && m.now >= m.eeprom_end)
+	{
+		m.eeprom[m.eeprom_address] = m.eeprom_value;
+		m.eeprom_busy = false;
+		m.io[io_eecr] &= ~(1<<1);
+		++m.eeprom_writes;
+	}
+}
+
+inline void eeprom_write_eecr(machine & m, uint8_t v)
+{
+	uint8_t const old = m.io[io_eecr];
+	bool const mwe = (old & (1<<2)) != 0;
+	uint16_t const address = ((m.io[io_earh] << 8) | m.io[io_earl]) & (eeprom_size - 1);
+
+	uint8_t res = (old & ((1<<2)|(1<<1))) | (v & (1<<3));
+	if ((v & (1<<2)) != 0 && !mwe)
+	{
+		res |= (1<<2);
+		m.eeprom_mwe_end = m.now + 4;
+	}
+
+	// The chip ignores EEWE without EEMWE and EERE during a write.
+	if ((v & (1<<1)) != 0 && !mwe && (old & (1<<1)) == 0)
+		++m.eeprom_errors;
+	if ((v & (1<<0)) != 0 && (old & (1<<1)) != 0)
+		++m.eeprom_errors;
+
+	if ((old & (1<<1)) == 0)
+	{
+		if ((v & (1<<1)) != 0 && mwe)
+		{
+			m.eeprom_busy = true;
+			m.eeprom_address = address;
+			m.eeprom_value = m.io[io_eedr];
+			m.eeprom_end = m.now + eeprom_write_cycles;
+			res = (res | (1<<1)) & ~(1<<2);
+		}
+		else if (v & (1<<0))
+		{
+			m.io[io_eedr] = m.eeprom[address];
+			m.now += 4;
+		}
+	}
+	m.io[io_eecr] = res;
+}
+
+inline void sync(machine & m)
+{
+	if (m.now < m.next_sync)
+		return;
+	m.next_sync = m.now + F_CPU / 1000;
+
+	if (m.limit != 0 && m.now >= m.limit)
+		halt(exit_ok);
+	// the end of the standard input counts only while it is attached
+	if (m.in_eof && !m.linger_forever && m.now - m.in_eof_time >= m.linger && m.usart[1].rx == &stdin_rx)
+		halt(exit_ok);
+
+	if (!m.realtime)
+		return;
+
+	fflush(stdout);
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	int64_t const wall = (t.tv_sec - m.wall_start.tv_sec) * 1000000000LL + (t.tv_nsec - m.wall_start.tv_nsec);
+	int64_t const sim = m.now * 1000 / (F_CPU / 1000000);
+	if (sim > wall + 1000000)
+	{
+		struct timespec d = { time_t((sim - wall) / 1000000000), long((sim - wall) % 1000000000) };
+		nanosleep(&d, 0);
+	}
+}
+
+// Advances the peripherals without taking interrupts.
+inline void run(cycle_t n)
+{
+	machine & m = mcu();
+	if (m.halted)
+		return;
+
+	while (n != 0)
+	{
+		cycle_t const step = n < max_step? n: max_step;
+		n -= step;
+		m.now += step;
+
+		if (m.adc_busy && !m.timers_halted)
+			m.adc_awake += step;
+		timers_step(m, step);
+		usart_step(m, 0);
+		usart_step(m, 1);
+		adc_step(m);
+		eeprom_step(m);
+		sync(m);
+	}
+}
+
+inline vector_source const * pending(machine & m)
+{
+	for (uint8_t i = 0; i != vector_source_count; ++i)
+	{
+		vector_source const & s = vector_sources[i];
+		if ((m.io[s.mask_reg] & s.mask) == 0)
+			continue;
+		bool const flag = (m.io[s.flag_reg] & s.flag) != 0;
+		if (flag != (s.kind == vector_level_inv))
+			return &s;
+	}
+	return 0;
+}
+
+inline void dispatch()
+{
+	machine & m = mcu();
+	while ((m.io[io_sreg] & 0x80) != 0 && !m.halted)
+	{
+		vector_source const * s = pending(m);
+		if (s == 0)
+			return;
+
+		if (s->kind == vector_flag)
+			m.io[s->flag_reg] &= ~s->flag;
+		isr_t const isr = m.vectors[s->vector];
+		if (isr == 0)
+			halt(exit_bad_interrupt, "unhandled interrupt");
+
+		++m.interrupts;
+		++m.vector_interrupts[s->vector];
+		m.io[io_sreg] &= ~0x80;
+		run(4);
+		isr();
+		run(4);
+		m.io[io_sreg] |= 0x80;
+	}
+}
+
+inline void tick(cycle_t n)
+{
+	run(n);
+	dispatch();
+}
+
+// Held by the entry points of the firmware into the model. The barriers
+// make the firmware code reload the state the spin handler may change.
+struct model_scope
+{
+	model_scope()
+	{
+		++mcu().depth;
+		asm volatile ("" : : : "memory");
+	}
+
+	~model_scope()
+	{
+		asm volatile ("" : : : "memory");
+		--mcu().depth;
+	}
+};
+
+inline uint8_t read_pin(machine & m, port_regs const & p, uint8_t i)
+{
+	uint8_t const ddr = m.io[p.ddr];
+	uint8_t const driven = m.drive_mask[i] & ~ddr;
+	return (m.io[p.port] & ddr) | (m.drive_level[i] & driven) | (m.io[p.port] & ~ddr & ~driven);
+}
+
+inline uint8_t io_read(uint8_t address)
+{
+	model_scope scope;
+	machine & m = mcu();
+	uint8_t v;
+	switch (address)
+	{
+	case io_udr0:
+		v = usart_read_udr(m, 0);
+		break;
+	case io_udr1:
+		v = usart_read_udr(m, 1);
+		break;
+	case io_tcnt1l:
+	case io_icr1l:
+		v = m.io[address];
+		m.timer_temp[0] = m.io[address + 1];
+		break;
+	case io_tcnt1l + 1:
+	case io_icr1l + 1:
+		v = m.timer_temp[0];
+		break;
+	case io_tcnt3l:
+	case io_icr3l:
+		v = m.io[address];
+		m.timer_temp[1] = m.io[address + 1];
+		break;
+	case io_tcnt3l + 1:
+	case io_icr3l + 1:
+		v = m.timer_temp[1];
+		break;
+	default:
+		v = m.io[address];
+		for (uint8_t i = 0; i != port_count; ++i)
+		{
+			if (ports[i].pin == address)
+				v = read_pin(m, ports[i], i);
+		}
+		break;
+	}
+	tick(io_access_cycles);
+	return v;
+}
+
+inline void io_write(uint8_t address, uint8_t v)
+{
+	model_scope scope;
+	machine & m = mcu();
+	switch (address)
+	{
+	case io_sreg:
+		m.io[address] = v;
+		break;
+	case io_udr0:
+		usart_write_udr(m, 0, v);
+		break;
+	case io_udr1:
+		usart_write_udr(m, 1, v);
+		break;
+	case io_ucsr0a:
+	case io_ucsr1a:
+		// TXC is cleared by writing one, U2X and MPCM are writable
+		m.io[address] = (m.io[address] & ~(usart_txc | 0x03)) | (v & 0x03);
+		if (v & usart_txc)
+			m.io[address] &= ~usart_txc;
+		break;
+	case io_tifr:
+	case io_etifr:
+	case io_eifr:
+		m.io[address] &= ~v;
+		break;
+	case io_adcsra:
+		adc_write_adcsra(m, v);
+		break;
+	case io_eecr:
+		eeprom_write_eecr(m, v);
+		break;
+	case io_eedr:
+	case io_earl:
+	case io_earh:
+		// the address and the data must not change during a write
+		if (m.eeprom_busy)
+			++m.eeprom_errors;
+		m.io[address] = v;
+		break;
+	case io_sfior:
+		// PSR0 and PSR321 reset the prescalers and read as zero
+		m.io[address] = v & ~3;
+		if (v & (1<<1))
+			m.timer0_prescaler = 0;
+		if (v & (1<<0))
+			m.prescaler321 = 0;
+		break;
+	case io_wdtcr:
+		m.io[address] = v;
+		if (v & (1<<3))
+			halt(exit_reset, "watchdog reset");
+		break;
+	case io_adcl:
+	case io_adch:
+	case io_pina:
+	case io_pinb:
+	case io_pinc:
+	case io_pind:
+	case io_pine:
+	case io_pinf:
+	case io_ping:
+		break;
+	case io_tcnt1l + 1: case io_icr1l + 1: case io_ocr1al + 1: case io_ocr1bl + 1: case io_ocr1cl + 1:
+		m.timer_temp[0] = v;
+		break;
+	case io_tcnt1l: case io_icr1l: case io_ocr1al: case io_ocr1bl: case io_ocr1cl:
+		m.io[address] = v;
+		m.io[address + 1] = m.timer_temp[0];
+		break;
+	case io_tcnt3l + 1: case io_icr3l + 1: case io_ocr3al + 1: case io_ocr3bl + 1: case io_ocr3cl + 1:
+		m.timer_temp[1] = v;
+		break;
+	case io_tcnt3l: case io_icr3l: case io_ocr3al: case io_ocr3bl: case io_ocr3cl:
+		m.io[address] = v;
+		m.io[address + 1] = m.timer_temp[1];
+		break;
+	default:
+		m.io[address] = v;
+		break;
+	}
+	tick(io_access_cycles);
+}
+
+inline void sei()
+{
+	model_scope scope;
+	io(io_sreg) |= 0x80;
+	tick(1);
+}
+
+inline void cli()
+{
+	model_scope scope;
+	io(io_sreg) &= ~0x80;
+	run(1);
+}
+
+// Sleeps until an interrupt that wakes the CPU up in the selected mode is
+// pending; the timers stop in the modes other than idle.
+inline void sleep()
+{
+	model_scope scope;
+	machine & m = mcu();
+	uint8_t const mcucr = m.io[io_mcucr];
+	if ((mcucr & (1<<5)) == 0)
+		return;
+
+	uint8_t const mode = mcucr & ((1<<4)|(1<<3)|(1<<2));
+	bool const deep = mode != 0;
+
+	// ADC noise reduction starts a conversion by itself
+	if (mode == (1<<3) && (m.io[io_adcsra] & (1<<7)) != 0 && !m.adc_busy)
+		adc_start(m);
+
+	cycle_t const start = m.now;
+	m.timers_halted = deep;
+	for (;;)
+	{
+		vector_source const * s = pending(m);
+		if (s != 0 && (!deep || wakes_from_deep_sleep(s->vector)))
+			break;
+		run(max_step);
+	}
+	m.timers_halted = false;
+	m.sleep_cycles += m.now - start;
+	tick(4);
+}
+
+inline void delay(cycle_t n)
+{
+	model_scope scope;
+	tick(n);
+}
+
+// The signal handler of the spin check. The time has not passed since the
+// previous signal only if the firmware spins outside the model.
+inline void spin_check(int)
+{
+	machine & m = mcu();
+	if (m.depth != 0 || m.halted || (m.io[io_sreg] & 0x80) == 0 || m.now != m.spin_mark)
+	{
+		m.spin_mark = m.now;
+		return;
+	}
+
+	++m.depth;
+	cycle_t const end = m.now + spin_quantum;
+	while (m.now < end && pending(m) == 0 && !m.halted)
+		run(max_step);
+	dispatch();
+	++m.spin_wakes;
+	m.spin_mark = m.now;
+	--m.depth;
+}
+
+inline void init(machine & m)
+{
+	m.ready = true;
+
+	m.io[io_ucsr0a] = usart_udre;
+	m.io[io_ucsr1a] = usart_udre;
+	m.usart[0].tx = &discard_tx;
+	m.usart[1].rx = &stdin_rx;
+	m.usart[1].tx = &stdout_tx;
+
+	m.adc_first = true;
+	for (uint8_t i = 0; i != 8; ++i)
+		m.adc_inputs[i] = 512;
+	if (char const * s = getenv("AVRLIB_HOST_ADC"))
+	{
+		for (uint8_t i = 0; i != 8 && *s != 0; ++i)
+		{
+			char * end;
+			m.adc_inputs[i] = strtoul(s, &end, 0) & 0x3ff;
+			s = *end == ','? end + 1: end;
+		}
+	}
+
+	for (uint8_t i = 0; i != port_count; ++i)
+	{
+		char name[] = "AVRLIB_HOST_PINA";
+		name[sizeof name - 2] += i;
+		if (char const * s = getenv(name))
+		{
+			m.drive_mask[i] = 0xff;
+			m.drive_level[i] = strtoul(s, 0, 0);
+		}
+	}
+
+	memset(m.eeprom, 0xff, sizeof m.eeprom);
+	m.eeprom_path = getenv("AVRLIB_HOST_EEPROM");
+	if (m.eeprom_path)
+	{
+		if (FILE * f = fopen(m.eeprom_path, "rb"))
+		{
+			if (fread(m.eeprom, 1, eeprom_size, f) != eeprom_size)
+				fprintf(stderr, "avrlib host: %s is short, the rest is erased\n", m.eeprom_path);
+			fclose(f);
+		}
+	}
+
+	if (char const * s = getenv("AVRLIB_HOST_TIME"))
+		m.limit = cycle_t(atof(s) * F_CPU);
+
+	m.linger = F_CPU;
+	if (char const * s = getenv("AVRLIB_HOST_LINGER"))
+	{
+		double const ms = atof(s);
+		m.linger_forever = ms < 0;
+		m.linger = cycle_t(ms * (F_CPU / 1000));
+	}
+
+	char const * realtime = getenv("AVRLIB_HOST_REALTIME");
+	m.realtime = realtime? atoi(realtime) != 0: isatty(0);
+	clock_gettime(CLOCK_MONOTONIC, &m.wall_start);
+
+	atexit(&shutdown);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = &spin_check;
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGALRM, &sa, 0);
+	struct itimerval period = { { 0, spin_period_us }, { 0, spin_period_us } };
+	setitimer(ITIMER_REAL, &period, 0);
+}
+
+struct isr_entry
+{
+	isr_entry(uint8_t vector, isr_t isr)
+	{
+		mcu().vectors[vector] = isr;
+	}
+};
+
+// Stands for a register in the I/O space; an empty temporary, so that
+// every access goes through the machine.
+template <uint8_t Address>
+struct reg8
+{
+	static const uint8_t address = Address;
+
+	operator uint8_t() const { return io_read(Address); }
+
+	reg8 operator=(uint8_t v) { io_write(Address, v); return *this; }
+	reg8 operator|=(int v) { io_write(Address, io_read(Address) | v); return *this; }
+	reg8 operator&=(int v) { io_write(Address, io_read(Address) & v); return *this; }
+	reg8 operator^=(int v) { io_write(Address, io_read(Address) ^ v); return *this; }
+
+	// Bypasses the peripherals.
+	volatile uint8_t * operator&() const { return &io(Address); }
+};
+
+// The low byte is read first and written last, as the TEMP register of
+// the 16-bit timers requires.
+template <uint8_t Address>
+struct reg16
+{
+	static const uint8_t address = Address;
+
+	operator uint16_t() const
+	{
+		uint16_t res = io_read(Address);
+		return res | (io_read(Address + 1) << 8);
+	}
+
+	reg16 operator=(uint16_t v)
+	{
+		io_write(Address + 1, v >> 8);
+		io_write(Address, v & 0xff);
+		return *this;
+	}
+
+	reg16 operator|=(int v) { return *this = uint16_t(*this | v); }
+	reg16 operator&=(int v) { return *this = uint16_t(*this & v); }
+
+	volatile uint16_t * operator&() const { return (volatile uint16_t *)&io(Address); }
+};
+
+}
+}
+
+#endif
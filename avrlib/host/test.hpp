@@ -0,0 +1,49 @@
+#ifndef AVRLIB_HOST_TEST_HPP
+#define AVRLIB_HOST_TEST_HPP
+
+// Checks of the host tests, built and run by `make test`.
+//
+// A failed check prints its place and the test goes on, so that a run
+// shows all the failures; test_result() prints the verdict and gives the
+// exit code of the test.
+
+#include <stdio.h>
+
+namespace avrlib {
+namespace host {
+
+static const unsigned test_max_reports = 20;
+
+inline unsigned & test_failures()
+{
+	static unsigned failures = 0;
+	return failures;
+}
+
+inline bool test_check(bool ok, char const * expr, char const * file, int line)
+{
+	if (ok)
+		return true;
+	if (++test_failures() <= test_max_reports)
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+	return false;
+}
+
+inline int test_result(char const * name)
+{
+	unsigned const failures = test_failures();
+	if (failures == 0)
+		printf("%s: ok\n", name);
+	else
+		printf("%s: %u checks failed\n", name, failures);
+	fflush(stdout);
+	return failures == 0? 0: 1;
+}
+
+}
+}
+
+// Variadic for the commas of template arguments
+#define TEST_CHECK(...) ::avrlib::host::test_check(bool(__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,178 @@
+// The settings log against a power loss at every byte written to the
+// EEPROM of the model.
+//
+// A script of updates is run once and the byte writes it makes are
+// recorded. For every prefix of them the EEPROM is rebuilt as the power
+// loss would leave it, with the record being written torn, and a new log
+// is started on it: init() must recover for every key the value of its
+// last completed update or, for the key being updated, the new value.
+// The log then takes another update and has to recover it after a second
+// restart, with the torn record in its ring.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "../eeprom.hpp"
+#include "../eeprom_log.hpp"
+#include "bench.hpp"
+#include "test.hpp"
+
+using namespace avrlib;
+using avrlib::host::bench_random;
+
+typedef eeprom_writer<16> eeprom_t;
+eeprom_t eeprom;
+
+static const uint8_t keys = 3;
+static const uint8_t slots = 8;
+static const uint16_t offset = 64;
+static const uint16_t updates = 150;
+
+typedef eeprom_log<eeprom_t, keys, slots> log_t;
+
+struct byte_write
+{
+	uint16_t address;
+	uint8_t value;
+};
+
+static const uint16_t max_writes = updates * 3 * sizeof(eeprom_log_record);
+byte_write writes[max_writes];
+uint16_t write_count = 0;
+bool recording = false;
+
+ISR(EE_READY_vect)
+{
+	eeprom.intr();
+	if (recording && (EECR & (1<<EEWE)) && write_count != max_writes)
+	{
+		byte_write & w = writes[write_count++];
+		w.address = EEAR;
+		w.value = EEDR;
+	}
+}
+
+// Lets the time pass in large steps rather than by polling EECR.
+void flush()
+{
+	while (eeprom.busy())
+		host::delay(1024);
+}
+
+struct update
+{
+	uint8_t key;
+	uint32_t value;
+	uint32_t before[keys];
+	uint16_t done;      // byte writes when the update was complete
+};
+
+update script[updates];
+
+void record_script()
+{
+	memset(host::eeprom(), 0xff, host::eeprom_size);
+	log_t log(eeprom, offset);
+	log.init();
+
+	bench_random rnd;
+	uint32_t values[keys];
+	for (uint8_t k = 0; k != keys; ++k)
+		values[k] = 0xffffffff;
+
+	uint16_t appended = 0;
+	recording = true;
+	for (uint16_t i = 0; i != updates; ++i)
+	{
+		update & u = script[i];
+		// key 0 changes rarely and is moved along the ring
+		u.key = i % 16 == 0? 0: 1 + rnd() % (keys - 1);
+		// every fourth update repeats the value and is skipped
+		u.value = i % 4 == 3 && values[u.key] != 0xffffffff? values[u.key]: rnd();
+		memcpy(u.before, values, sizeof values);
+		if (u.value != values[u.key])
+			++appended;
+
+		log.set(u.key, u.value);
+		flush();
+		values[u.key] = u.value;
+		u.done = write_count;
+	}
+	recording = false;
+
+	TEST_CHECK(write_count < max_writes);
+	TEST_CHECK(log.writes() > appended + updates / 16);
+	printf("%u updates, %u appended, %u records with the moves, %u byte writes\n",
+		updates, appended, log.writes(), write_count);
+}
+
+// The value the update leaves a key with; unset keys have none.
+bool expected(update const & u, uint8_t key, uint32_t & value)
+{
+	value = key == u.key? u.value: u.before[key];
+	return value != 0xffffffff;
+}
+
+bool matches(log_t const & log, uint8_t key, uint32_t value, bool has_value)
+{
+	uint32_t v;
+	if (!log.get(key, v))
+		return !has_value;
+	return has_value && v == value;
+}
+
+void check_cut(uint16_t cut, update const & u)
+{
+	memset(host::eeprom(), 0xff, host::eeprom_size);
+	for (uint16_t i = 0; i != cut; ++i)
+		host::eeprom()[writes[i].address] = writes[i].value;
+
+	log_t log(eeprom, offset);
+	log.init();
+
+	for (uint8_t k = 0; k != keys; ++k)
+	{
+		uint32_t const before = u.before[k];
+		uint32_t after;
+		bool const has_after = expected(u, k, after);
+		bool const ok = matches(log, k, after, has_after)
+			|| (k == u.key && cut != u.done && matches(log, k, before, before != 0xffffffff));
+		if (!TEST_CHECK(ok))
+			fprintf(stderr, "  power lost after %u byte writes, key %u\n", cut, k);
+	}
+
+	// the restarted log goes on over the torn record
+	uint32_t values[keys];
+	bool has[keys];
+	for (uint8_t k = 0; k != keys; ++k)
+		has[k] = log.get(k, values[k]);
+	uint8_t const key = cut % keys;
+	values[key] = 0x5a000000 | cut;
+	has[key] = true;
+	log.set(key, values[key]);
+	flush();
+
+	log_t again(eeprom, offset);
+	again.init();
+	for (uint8_t k = 0; k != keys; ++k)
+	{
+		if (!TEST_CHECK(matches(again, k, values[k], has[k])))
+			fprintf(stderr, "  second restart after %u byte writes, key %u\n", cut, k);
+	}
+}
+
+int main()
+{
+	sei();
+	record_script();
+
+	uint16_t u = 0;
+	for (uint16_t cut = 0; cut <= write_count; ++cut)
+	{
+		while (u + 1 != updates && script[u].done < cut)
+			++u;
+		// until the update is complete, the key may hold either value
+		check_cut(cut, script[u]);
+	}
+	return host::test_result("eeprom_log");
+}
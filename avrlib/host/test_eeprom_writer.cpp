@@ -0,0 +1,144 @@
+// The queued EEPROM writer against the EEPROM of the model, which takes
+// 8.5ms per byte and counts the register accesses the chip would ignore
+// or corrupt during a write.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "../eeprom.hpp"
+#include "test.hpp"
+
+using namespace avrlib;
+using avrlib::host::cycles;
+using avrlib::host::eeprom_write_cycles;
+
+typedef eeprom_writer<16> eeprom_t;
+eeprom_t eeprom;
+
+// The cells in the order their writes were started
+uint16_t started[256];
+uint16_t started_count = 0;
+
+ISR(EE_READY_vect)
+{
+	eeprom.intr();
+	if (EECR & (1<<EEWE))
+		started[started_count++ % 256] = EEAR;
+}
+
+host::machine & m = host::mcu();
+
+void reset(uint8_t fill)
+{
+	eeprom.flush();
+	memset(host::eeprom(), fill, host::eeprom_size);
+	eeprom.clear_stats();
+	started_count = 0;
+}
+
+// Unchanged bytes are compared and dropped without a write.
+void test_skip_unchanged()
+{
+	reset(0x5a);
+	uint32_t const writes = m.eeprom_writes;
+	host::cycle_t const c0 = cycles();
+
+	uint8_t same[12];
+	memset(same, 0x5a, sizeof same);
+	eeprom.write(100, same, sizeof same);
+	eeprom.flush();
+
+	TEST_CHECK(m.eeprom_writes == writes);
+	TEST_CHECK(eeprom.skipped() == sizeof same);
+	TEST_CHECK(eeprom.written() == 0);
+	TEST_CHECK(cycles() - c0 < eeprom_write_cycles);
+
+	// one changed byte among them costs one write
+	same[5] = 0xa5;
+	eeprom.write(100, same, sizeof same);
+	eeprom.flush();
+	TEST_CHECK(m.eeprom_writes == writes + 1);
+	TEST_CHECK(eeprom.written() == 1);
+	TEST_CHECK(host::eeprom()[105] == 0xa5);
+}
+
+// write() returns at once while there is room in the queue and load()
+// sees the queued values before they reach the cells.
+void test_load_overlay()
+{
+	reset(0xff);
+	uint8_t const data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+	host::cycle_t const c0 = cycles();
+	eeprom.write(200, data, sizeof data);
+	TEST_CHECK(cycles() - c0 < eeprom_write_cycles / 10);
+	TEST_CHECK(eeprom.busy());
+	TEST_CHECK(host::eeprom()[207] == 0xff);
+
+	uint8_t buf[10];
+	eeprom.load(199, buf, sizeof buf);
+	TEST_CHECK(buf[0] == 0xff);
+	TEST_CHECK(memcmp(buf + 1, data, sizeof data) == 0);
+	TEST_CHECK(buf[9] == 0xff);
+
+	// the latest of two queued values of a cell
+	eeprom.write(203, uint8_t(0x33));
+	uint8_t v = 0;
+	eeprom.load(203, v);
+	TEST_CHECK(v == 0x33);
+
+	eeprom.flush();
+	TEST_CHECK(!eeprom.busy());
+	TEST_CHECK(eeprom.pending() == 0);
+	TEST_CHECK(memcmp(host::eeprom() + 200, data, 3) == 0);
+	TEST_CHECK(host::eeprom()[203] == 0x33);
+	TEST_CHECK(memcmp(host::eeprom() + 204, data + 4, 4) == 0);
+}
+
+// The writes are started in the order they were queued, each after the
+// previous one has finished, also when write() has to wait for room.
+void test_flush_order()
+{
+	reset(0x00);
+	host::cycle_t const c0 = cycles();
+
+	uint16_t const count = 40;
+	for (uint16_t i = 0; i != count; ++i)
+		eeprom.write(uint16_t(1000 + (i * 37) % 101), uint8_t(i + 1));
+	eeprom.flush();
+
+	TEST_CHECK(started_count == count);
+	for (uint16_t i = 0; i != count && i != 256; ++i)
+		TEST_CHECK(started[i] == 1000 + (i * 37) % 101);
+	for (uint16_t i = 0; i != count; ++i)
+		TEST_CHECK(host::eeprom()[1000 + (i * 37) % 101] == i + 1);
+
+	// the writes take their 8.5ms one after another
+	TEST_CHECK(cycles() - c0 >= count * eeprom_write_cycles);
+	TEST_CHECK(cycles() - c0 < (count + 1) * eeprom_write_cycles);
+}
+
+// The polled flush finishes the queue with the interrupts disabled.
+void test_flush_nointr()
+{
+	reset(0x00);
+	eeprom.write(3000, uint32_t(0xdeadbeef));
+	cli();
+	eeprom.flush_nointr();
+	TEST_CHECK((EECR & (1<<EEWE)) == 0);
+	sei();
+	uint32_t v = 0;
+	memcpy(&v, host::eeprom() + 3000, sizeof v);
+	TEST_CHECK(v == 0xdeadbeef);
+}
+
+int main()
+{
+	sei();
+	test_skip_unchanged();
+	test_load_overlay();
+	test_flush_order();
+	test_flush_nointr();
+	TEST_CHECK(m.eeprom_errors == 0);
+	return host::test_result("eeprom_writer");
+}
@@ -0,0 +1,147 @@
+// The axis filters against a synthetic stick trace: a centered stick with
+// the noise of the ADC and occasional spikes of the digital noise, then a
+// step. The noise left in the output and the delay of the step are
+// printed for each filter; the checks hold the filter of the firmware,
+// 4 times oversampling and an IIR with alpha = 1/4, to its design.
+
+#include <math.h>
+
+#include "../filter.hpp"
+#include "bench.hpp"
+#include "test.hpp"
+
+using namespace avrlib;
+using avrlib::host::bench_random;
+
+static const uint16_t trace_size = 16384;
+static const int16_t center = 512;
+static const int16_t step_from = 300;
+static const int16_t step_to = 700;
+static const uint8_t spike_period = 50;
+static const int16_t spike = 60;
+
+int16_t noisy[trace_size];
+
+// Half the sum of four uniform samples, close to a normal noise with a
+// sigma of 4.9 LSB, and a spike every spike_period samples
+void make_trace()
+{
+	bench_random rnd;
+	for (uint16_t i = 0; i != trace_size; ++i)
+	{
+		int16_t n = 0;
+		for (uint8_t j = 0; j != 4; ++j)
+			n += int16_t(rnd() % 17) - 8;
+		noisy[i] = center + n / 2 + (i % spike_period == spike_period - 1? spike: 0);
+	}
+}
+
+struct stats
+{
+	double mean;
+	double sigma;
+};
+
+template <typename T>
+stats measure(T const * v, uint16_t n)
+{
+	double sum = 0;
+	double sum2 = 0;
+	for (uint16_t i = 0; i != n; ++i)
+	{
+		sum += v[i];
+		sum2 += double(v[i]) * v[i];
+	}
+	stats res;
+	res.mean = sum / n;
+	res.sigma = sqrt(sum2 / n - res.mean * res.mean);
+	return res;
+}
+
+struct result
+{
+	stats noise;
+	uint16_t half;      // samples until half of the step
+	uint16_t settle;    // samples until within 1 LSB of the step
+	int16_t overshoot;
+	int16_t final_value;
+};
+
+template <typename Filter>
+result run(Filter & f)
+{
+	static int16_t out[trace_size];
+	uint16_t outputs = 0;
+	for (uint16_t i = 0; i != trace_size; ++i)
+	{
+		if (f.add(noisy[i]))
+			out[outputs++] = f.value();
+	}
+
+	result res;
+	// without the start-up transient
+	res.noise = measure(out + outputs / 8, outputs - outputs / 8);
+
+	for (uint16_t i = 0; i != 256; ++i)
+		f.add(step_from);
+	res.half = 0;
+	res.settle = 0;
+	res.overshoot = 0;
+	for (uint16_t i = 1; i != 1024; ++i)
+	{
+		f.add(step_to);
+		int16_t const v = f.value();
+		if (res.half == 0 && v >= (step_from + step_to) / 2)
+			res.half = i;
+		if (res.settle == 0 && v >= step_to - 1)
+			res.settle = i;
+		if (v - step_to > res.overshoot)
+			res.overshoot = v - step_to;
+	}
+	res.final_value = f.value();
+	return res;
+}
+
+template <typename Filter>
+result report(char const * name)
+{
+	Filter f;
+	result const res = run(f);
+	printf("%-24s mean %7.2f sigma %5.2f half %3u settle %3u samples\n", name,
+		res.noise.mean, res.noise.sigma, res.half, res.settle);
+	return res;
+}
+
+int main()
+{
+	make_trace();
+	stats const in = measure(noisy, trace_size);
+	printf("%-24s mean %7.2f sigma %5.2f\n", "input", in.mean, in.sigma);
+
+	report<oversampled_filter<1, null_filter<int16_t> > >("none");
+	report<oversampled_filter<4, null_filter<int16_t> > >("oversampled 4");
+	report<oversampled_filter<1, iir_filter<int16_t, 2> > >("iir 1/4");
+	result const median = report<oversampled_filter<1, median3_filter<int16_t> > >("median3");
+	report<oversampled_filter<4, median3_filter<int16_t> > >("oversampled 4, median3");
+	result const axis = report<oversampled_filter<4, iir_filter<int16_t, 2> > >("oversampled 4, iir 1/4");
+
+	// The averages of 4 and the IIR take the variance down to 1/4 * 1/7 of
+	// the input, i.e. the sigma to 0.19 of it; the rounding of the output
+	// adds a little.
+	TEST_CHECK(axis.noise.sigma < in.sigma * 0.25);
+	TEST_CHECK(fabs(axis.noise.mean - in.mean) < 0.5);
+
+	// 0.75^3 of the step is left after the third output, i.e. 12 samples;
+	// 0.75^21 of it is below 1 LSB.
+	TEST_CHECK(axis.half > 8 && axis.half <= 12);
+	TEST_CHECK(axis.settle != 0 && axis.settle <= 4 * 22);
+	TEST_CHECK(axis.overshoot == 0);
+	TEST_CHECK(axis.final_value == step_to);
+
+	// the spikes are single samples
+	TEST_CHECK(median.noise.mean < in.mean - 0.5);
+	TEST_CHECK(median.half == 2);
+	TEST_CHECK(median.final_value == step_to);
+
+	return host::test_result("filter");
+}
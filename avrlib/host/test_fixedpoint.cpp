@@ -0,0 +1,87 @@
+// The calibration arithmetic over every extent and every deviation of a
+// 10-bit axis: the 8.8 gains of full_scale_gain() take every extent from
+// 128 counts up to exactly full scale and every deviation within it into
+// range, never short of the exact product. The integer gains of the older
+// firmware are counted for the comparison.
+
+#include <stdlib.h>
+
+#include "../fixedpoint.hpp"
+#include "test.hpp"
+
+using namespace avrlib;
+
+typedef fixedpoint<uint16_t, 8> gain_t;
+
+static const int16_t max_extent = 1023;
+
+// 8.8 bits reach 255.996, so shorter extents cannot be scaled up to
+// 32767.
+static const int16_t min_full_extent = 128;
+
+void test_mul_sat()
+{
+	gain_t const one(1);
+	TEST_CHECK(mul_sat(int16_t(100), one) == 100);
+	TEST_CHECK(mul_sat(int16_t(-100), one) == -100);
+	TEST_CHECK(mul_sat(int16_t(32767), gain_t(2)) == 32767);
+	TEST_CHECK(mul_sat(int16_t(-32767), gain_t(2)) == -32767);
+
+	// halves away from zero: 3 * 0.5 = 1.5
+	gain_t const half(uint16_t(128), 8);
+	TEST_CHECK(mul_sat(int16_t(3), half) == 2);
+	TEST_CHECK(mul_sat(int16_t(-3), half) == -2);
+
+	TEST_CHECK(div_sat<uint16_t, 8>(1, 2).get_raw() == 128);
+	TEST_CHECK(div_sat<uint16_t, 8>(32767, 1).get_raw() == 0xffff);
+}
+
+void test_gains()
+{
+	uint16_t legacy_short = 0;
+	int16_t legacy_worst = 32767;
+	for (int16_t extent = 1; extent <= max_extent; ++extent)
+	{
+		gain_t const g = full_scale_gain<uint16_t, 8>(extent);
+		int16_t const top = mul_sat(extent, g);
+		if (extent >= min_full_extent)
+			TEST_CHECK(top == 32767);
+		else
+			TEST_CHECK(g.get_raw() == 0xffff);
+
+		int16_t prev = -1;
+		for (int16_t d = 0; d <= extent; ++d)
+		{
+			int16_t const v = mul_sat(d, g);
+			int32_t const exact = int32_t(d) * 32767 / extent;
+
+			TEST_CHECK(v >= 0 && v <= 32767);
+			TEST_CHECK(v >= prev);
+			TEST_CHECK(mul_sat(int16_t(-d), g) == -v);
+
+			// the gain is rounded up by less than 2/256, the product to
+			// nearest
+			if (extent >= min_full_extent)
+				TEST_CHECK(v >= exact && v <= exact + 2 * d / 256 + 1);
+			prev = v;
+		}
+
+		int32_t const legacy = int32_t(extent) * (32767 / extent);
+		if (legacy < 32767)
+		{
+			++legacy_short;
+			if (legacy < legacy_worst)
+				legacy_worst = legacy;
+		}
+	}
+
+	printf("extents 1 to %d: integer gains short of full scale for %u, down to %d; 8.8 gains for none from %d\n",
+		max_extent, legacy_short, legacy_worst, min_full_extent);
+}
+
+int main()
+{
+	test_mul_sat();
+	test_gains();
+	return host::test_result("fixedpoint");
+}
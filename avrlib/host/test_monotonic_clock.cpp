@@ -0,0 +1,139 @@
+// The monotonic clock on timer0 across the overflows and the wraparound.
+//
+// The timer is started two ticks before an overflow and read after every
+// possible delay within three ticks, so that the overflow falls on every
+// register access of value() and value_nointr(). The overflow count is
+// preset, so that the overflow also carries into the upper bytes of the
+// count and wraps the 32-bit time.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "../timer0.hpp"
+#include "../monotonic_clock.hpp"
+#include "test.hpp"
+
+using namespace avrlib;
+using avrlib::host::cycles;
+
+typedef monotonic_clock<timer0, timer_fosc_1024> systimer_t;
+systimer_t timer;
+
+ISR(TIMER0_OVF_vect)
+{
+	timer.tov_interrupt();
+}
+
+static const uint16_t prescaler = systimer_t::prescaler;
+static const uint8_t start_count = 0xfe;
+
+// Starts the clock at the time (overflows << 8) | start_count with the
+// prescaler reset, returns the cycle of the start. The flag is cleared
+// last, as the previous run may overflow while the timer is being set.
+host::cycle_t restart(uint32_t overflows)
+{
+	cli();
+	SFIOR = (1<<PSR0);
+	TCNT0 = start_count;
+	TIFR = (1<<TOV0);
+	timer.overflows(overflows);
+	return cycles();
+}
+
+// The time read between the cycles c1 and c2 must be the ticks counted
+// from the start, give or take the phase of the prescaler.
+bool in_window(uint32_t t, uint32_t base, host::cycle_t c0, host::cycle_t c1, host::cycle_t c2)
+{
+	uint32_t const lo = base + uint32_t((c1 - c0) / prescaler);
+	uint32_t const hi = base + uint32_t((c2 - c0) / prescaler) + 1;
+	return uint32_t(t - lo) <= uint32_t(hi - lo);
+}
+
+void test_reads(uint32_t overflows)
+{
+	uint32_t const base = (overflows << 8) | start_count;
+	for (uint16_t k = 0; k != 3 * prescaler; ++k)
+	{
+		host::cycle_t const c0 = restart(overflows);
+		sei();
+		host::delay(k);
+		host::cycle_t const c1 = cycles();
+		uint32_t const t = timer.value();
+		host::cycle_t const c2 = cycles();
+		TEST_CHECK(in_window(t, base, c0, c1, c2));
+	}
+
+	// in a handler the pending overflow is not taken
+	for (uint16_t k = 0; k != 3 * prescaler; ++k)
+	{
+		host::cycle_t const c0 = restart(overflows);
+		host::delay(k);
+		host::cycle_t const c1 = cycles();
+		uint32_t const t = timer.value_nointr();
+		host::cycle_t const c2 = cycles();
+		sei();
+		TEST_CHECK(in_window(t, base, c0, c1, c2));
+	}
+}
+
+// Consecutive reads never go back, also across the wraparound.
+void test_monotonic()
+{
+	restart(0xffffff);
+	sei();
+	uint32_t prev = timer.value();
+	bool wrapped = false;
+	for (uint16_t i = 0; i != 2000; ++i)
+	{
+		uint32_t const t = timer.value();
+		TEST_CHECK(!time_before(t, prev));
+		TEST_CHECK(uint32_t(t - prev) <= 1);
+		wrapped = wrapped || t < prev;
+		prev = t;
+	}
+	TEST_CHECK(wrapped);
+}
+
+void test_ordering()
+{
+	TEST_CHECK(time_before(uint32_t(0xffffff00), uint32_t(0x10)));
+	TEST_CHECK(time_after(uint32_t(0x10), uint32_t(0xffffff00)));
+	TEST_CHECK(!time_before(uint32_t(0x10), uint32_t(0xffffff00)));
+	TEST_CHECK(!time_before(uint32_t(5), uint32_t(5)));
+	TEST_CHECK(time_before(uint32_t(0x7ffffffe), uint32_t(0xfffffffd)));
+	TEST_CHECK(time_before(uint8_t(250), uint8_t(3)));
+}
+
+// The 32-bit conversions against the 64-bit arithmetic, also for a clock
+// whose tick is not a whole number of microseconds
+template <uint32_t Fosc, timer_clock_source Source>
+void test_conversions()
+{
+	typedef monotonic_clock<timer0, Source, uint32_t, Fosc> clock_type;
+	uint32_t t = 0;
+	for (uint32_t i = 0; i != 100000; ++i)
+	{
+		t = i < 50000? i: t * 69069 + 1;
+		TEST_CHECK(clock_type::to_us(t) == uint32_t(uint64_t(t) * clock_type::prescaler * 1000000 / Fosc));
+		TEST_CHECK(clock_type::to_ms(t) == uint32_t(uint64_t(t) * clock_type::prescaler * 1000 / Fosc));
+	}
+}
+
+int main()
+{
+	test_ordering();
+
+	TEST_CHECK(systimer_t::ms<1000>::value == 15625);
+	TEST_CHECK(systimer_t::us<8192>::value == 128);
+	TEST_CHECK(systimer_t::ticks<15625>::ms == 1000);
+	test_conversions<F_CPU, timer_fosc_1024>();
+	test_conversions<F_CPU, timer_fosc_8>();
+	test_conversions<14745600, timer_fosc_1024>();
+	test_conversions<14745600, timer_fosc_64>();
+
+	test_reads(0);
+	test_reads(0xffff);
+	test_reads(0xffffff);
+	test_monotonic();
+	return host::test_result("monotonic_clock");
+}
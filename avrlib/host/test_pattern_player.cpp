@@ -0,0 +1,194 @@
+// The pattern player on the compare matches of Timer1 in the model.
+//
+// Every edge of a pattern has to come at its time from the start within
+// the latency of the interrupt, including the edges across the wrap of
+// the timer and those after an interrupt held off by a critical section,
+// which must not push the rest back. stop() has to leave the output off
+// and the compare interrupt disabled, whatever the edge it comes at.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "../timer1.hpp"
+#include "../pattern_player.hpp"
+#include "test.hpp"
+
+using namespace avrlib;
+using avrlib::host::cycle_t;
+using avrlib::host::cycles;
+
+struct edge
+{
+	cycle_t time;
+	bool on;
+	uint8_t arg;
+};
+
+static const uint8_t max_edges = 32;
+
+struct recorder
+{
+	typedef uint8_t arg_type;
+
+	recorder()
+		: count(0), on(false)
+	{
+	}
+
+	void set(uint8_t arg)
+	{
+		this->add(true, arg);
+	}
+
+	void clear()
+	{
+		this->add(false, 0);
+	}
+
+	void add(bool state, uint8_t arg)
+	{
+		on = state;
+		if (count == max_edges)
+			return;
+		edge & e = edges[count++];
+		e.time = cycles();
+		e.on = state;
+		e.arg = arg;
+	}
+
+	edge edges[max_edges];
+	uint8_t count;
+	bool on;
+};
+
+typedef pattern_player<timer1, timer1::ocra, recorder> player_t;
+
+recorder out;
+player_t player(out);
+
+ISR(TIMER1_COMPA_vect)
+{
+	player.intr();
+}
+
+// Timer1 at fosc/8
+static const cycle_t tick_cycles = 8;
+
+// The compare match is taken within a step of the peripherals and the
+// entry of the handler.
+static const cycle_t latency = host::max_step + 16;
+
+// A tick at a time, as delay() only takes the interrupts at its end
+void wait_ticks(uint32_t ticks)
+{
+	for (; ticks != 0; --ticks)
+		host::delay(tick_cycles);
+}
+
+struct expected_edge
+{
+	uint16_t ticks;
+	bool on;
+	uint8_t arg;
+};
+
+// Three beeps, a rest and a double beep without a gap
+static expected_edge const pattern_edges[] = {
+	{   0, true,  7 },
+	{ 100, false, 0 },
+	{ 150, true,  7 },
+	{ 250, false, 0 },
+	{ 300, true,  7 },
+	{ 400, false, 0 },
+	{ 650, true,  9 },
+	{ 680, false, 0 },
+	{ 680, true,  9 },
+	{ 710, false, 0 }
+};
+
+static const uint8_t pattern_edge_count = sizeof pattern_edges / sizeof pattern_edges[0];
+
+// The edge held off by the critical section and how long
+static const uint8_t held_edge = 3;
+static const uint16_t held_ticks = 30;
+
+static player_t::step const pattern[] = {
+	{ 100, 50,  3, 7 },
+	{ 0,   200, 1, 0 },
+	{ 30,  0,   2, 9 }
+};
+
+void test_pattern()
+{
+	out.count = 0;
+
+	// the pattern runs across the wrap of the timer
+	cli();
+	timer1::value(0x10000 - 300);
+	sei();
+	TEST_CHECK(player.play(pattern, 3) == 3);
+	TEST_CHECK(player.active());
+	cycle_t const start = out.edges[0].time;
+
+	// the interrupts are held off over the edge at 250
+	wait_ticks(pattern_edges[held_edge].ticks - 10);
+	cli();
+	wait_ticks(held_ticks);
+	cycle_t const released = cycles();
+	sei();
+	TEST_CHECK(released > start + pattern_edges[held_edge].ticks * tick_cycles);
+
+	while (player.active())
+		wait_ticks(16);
+	TEST_CHECK(timer1::value() < 0x10000 - 300);
+
+	if (!TEST_CHECK(out.count == pattern_edge_count))
+		return;
+	for (uint8_t i = 0; i != pattern_edge_count; ++i)
+	{
+		expected_edge const & x = pattern_edges[i];
+		edge const & e = out.edges[i];
+		cycle_t const due = start + x.ticks * tick_cycles;
+		cycle_t const latest = (i == held_edge? released: due) + latency;
+		TEST_CHECK(e.on == x.on && e.arg == x.arg);
+		if (!TEST_CHECK(e.time >= due && e.time <= latest))
+			fprintf(stderr, "  edge %u at %ld cycles from its time\n", i, long(e.time - due));
+	}
+	TEST_CHECK(!out.on);
+	TEST_CHECK((TIMSK & (1<<OCIE1A)) == 0);
+}
+
+// Stops in the middle of a beep and in the middle of a gap.
+void test_stop(bool during_beep)
+{
+	out.count = 0;
+	player.play(1000, 1000, 5, 3);
+	wait_ticks(during_beep? 2500: 3500);
+	TEST_CHECK(out.on == during_beep);
+
+	player.stop();
+	TEST_CHECK(!out.on);
+	TEST_CHECK(!player.active());
+	TEST_CHECK((TIMSK & (1<<OCIE1A)) == 0);
+
+	uint8_t const count = out.count;
+	wait_ticks(20000);
+	TEST_CHECK(out.count == count);
+	TEST_CHECK(!out.on);
+
+	// and plays again from scratch
+	player.play(10, 0);
+	wait_ticks(20);
+	TEST_CHECK(out.count == count + 2 && !out.on);
+}
+
+int main()
+{
+	timer1::clock_source(timer_fosc_8);
+	sei();
+
+	test_pattern();
+	test_stop(true);
+	test_stop(false);
+	return host::test_result("pattern_player");
+}
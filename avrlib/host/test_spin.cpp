@@ -0,0 +1,76 @@
+// Loops that only poll the memory: the spin check of the model takes the
+// interrupts they wait for, one at a time and when they are due.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "test.hpp"
+
+using namespace avrlib;
+using avrlib::host::cycles;
+
+volatile uint16_t overflows = 0;
+volatile uint16_t overflow_seen = 0;
+host::cycle_t overflow_times[16];
+
+ISR(TIMER0_OVF_vect)
+{
+	if (overflows < 16)
+		overflow_times[overflows] = cycles();
+	++overflows;
+}
+
+// timer0 at fosc/8 overflows every 2048 cycles
+static const host::cycle_t overflow_cycles = 2048;
+
+void test_flag()
+{
+	cli();
+	TCCR0 = (1<<CS01);
+	TIMSK |= (1<<TOIE0);
+	sei();
+
+	host::cycle_t const c0 = cycles();
+	while (overflows < 10)
+	{
+	}
+	host::cycle_t const c1 = cycles();
+	uint16_t const seen = overflows;
+
+	TIMSK &= ~(1<<TOIE0);
+	TEST_CHECK(seen == 10);
+	TEST_CHECK(c1 - c0 >= 9 * overflow_cycles && c1 - c0 <= 10 * overflow_cycles + host::max_step);
+	TEST_CHECK(c1 >= overflow_times[9]);
+
+	// taken within a step of the peripherals, as from the sleep
+	for (uint8_t i = 1; i != 10; ++i)
+	{
+		host::cycle_t const d = overflow_times[i] - overflow_times[i - 1];
+		TEST_CHECK(d + host::max_step >= overflow_cycles && d <= overflow_cycles + host::max_step);
+	}
+	TEST_CHECK(host::mcu().spin_wakes >= 10);
+}
+
+// With the interrupts disabled nothing can end the loop; the model leaves
+// the time alone.
+void test_disabled()
+{
+	TIMSK |= (1<<TOIE0);
+	cli();
+	host::cycle_t const c0 = cycles();
+	uint32_t const wakes = host::mcu().spin_wakes;
+	for (volatile uint32_t i = 0; i != 20000000; ++i)
+	{
+	}
+	TEST_CHECK(cycles() == c0);
+	TEST_CHECK(host::mcu().spin_wakes == wakes);
+	sei();
+	TIMSK &= ~(1<<TOIE0);
+}
+
+int main()
+{
+	test_flag();
+	test_disabled();
+	return host::test_result("spin");
+}
@@ -0,0 +1,39 @@
+#ifndef AVRLIB_HOST_UTIL_CRC16_H
+#define AVRLIB_HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+// The C equivalents given in the documentation of avr-libc
+
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+	crc ^= a;
+	for (uint8_t i = 0; i < 8; ++i)
+		crc = (crc & 1)? (crc >> 1) ^ 0xA001: (crc >> 1);
+	return crc;
+}
+
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	crc = crc ^ ((uint16_t)data << 8);
+	for (uint8_t i = 0; i < 8; ++i)
+		crc = (crc & 0x8000)? (crc << 1) ^ 0x1021: (crc << 1);
+	return crc;
+}
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+	data ^= crc & 0xff;
+	data ^= data << 4;
+	return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+	crc = crc ^ data;
+	for (uint8_t i = 0; i < 8; ++i)
+		crc = (crc & 0x01)? (crc >> 1) ^ 0x8C: (crc >> 1);
+	return crc;
+}
+
+#endif
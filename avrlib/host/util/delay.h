@@ -0,0 +1,17 @@
+#ifndef AVRLIB_HOST_UTIL_DELAY_H
+#define AVRLIB_HOST_UTIL_DELAY_H
+
+#include <avr/io.h>
+
+// Busy waits pass the simulated time, with the interrupts taken.
+static inline void _delay_us(double us)
+{
+	::avrlib::host::delay(::avrlib::host::cycle_t(us * (F_CPU / 1e6)));
+}
+
+static inline void _delay_ms(double ms)
+{
+	::avrlib::host::delay(::avrlib::host::cycle_t(ms * (F_CPU / 1e3)));
+}
+
+#endif
@@ -62,6 +62,32 @@ inline uint8_t make_byte(
 	return b0 | (b1 << 1) | (b2 << 2) | (b3 << 3) | (b4 << 4) | (b5 << 5) | (b6 << 6) | (b7 << 7);
 }
 
+// Moves bits of a port value to their logical positions: bit i of the
+// result is taken from bit Si of the value, or is zero if Si is no_bit.
+// The permutation is resolved at compile time.
+static const uint8_t no_bit = 0xff;
+
+template <uint8_t S0, uint8_t S1 = no_bit, uint8_t S2 = no_bit, uint8_t S3 = no_bit,
+	uint8_t S4 = no_bit, uint8_t S5 = no_bit, uint8_t S6 = no_bit, uint8_t S7 = no_bit>
+struct bit_gather
+{
+	static uint8_t apply(uint8_t v)
+	{
+		return move<S0, 0>(v) | move<S1, 1>(v) | move<S2, 2>(v) | move<S3, 3>(v)
+			| move<S4, 4>(v) | move<S5, 5>(v) | move<S6, 6>(v) | move<S7, 7>(v);
+	}
+
+private:
+	template <uint8_t Src, uint8_t Dst>
+	static uint8_t move(uint8_t v)
+	{
+		if (Src == no_bit)
+			return 0;
+		uint8_t const b = v & (1<<(Src & 7));
+		return Src >= Dst? b >> ((Src - Dst) & 7): b << ((Dst - Src) & 7);
+	}
+};
+
 }
 
 #endif
@@ -0,0 +1,118 @@
+#ifndef AVRLIB_MONOTONIC_CLOCK_HPP
+#define AVRLIB_MONOTONIC_CLOCK_HPP
+
+#include <stdint.h>
+#include "counter.hpp"
+
+namespace avrlib {
+
+namespace detail {
+
+constexpr uint16_t clock_prescaler(timer_clock_source cs)
+{
+	return cs == timer_fosc_1? 1
+		: cs == timer_fosc_8? 8
+		: cs == timer_fosc_64? 64
+		: cs == timer_fosc_256? 256
+		: cs == timer_fosc_1024? 1024
+		: 0;
+}
+
+constexpr uint64_t gcd(uint64_t a, uint64_t b)
+{
+	return b == 0? a: gcd(b, a % b);
+}
+
+// t * Num / Den in 32 bits, exact as long as the result fits; the quotient
+// and the remainder come out of a single division by the constant.
+template <uint32_t Num, uint32_t Den>
+uint32_t scale(uint32_t t)
+{
+	static_assert(uint64_t(Num) * Den <= 0xffffffff, "the scale factor does not fit 32 bits");
+	if (Den == 1)
+		return t * Num;
+	return (t / Den) * Num + (t % Den) * Num / Den;
+}
+
+}
+
+// Wraparound-safe ordering of time stamps taken from a free-running clock.
+// Valid as long as the two stamps are less than half of the range apart.
+template <typename Time>
+bool time_before(Time lhs, Time rhs)
+{
+	return Time(lhs - rhs) > Time(Time(~Time(0)) >> 1);
+}
+
+template <typename Time>
+bool time_after(Time lhs, Time rhs)
+{
+	return time_before(rhs, lhs);
+}
+
+// A counter extended to the full width of Time, so that time differences
+// wrap around in modular arithmetic, together with compile-time conversions
+// between real units and ticks. The overflow counter is as wide as Time;
+// reads are made consistent by counter::value() rather than by masking
+// interrupts.
+template <typename Timer, timer_clock_source Source, typename Time = uint32_t, uint32_t Fosc = F_CPU>
+class monotonic_clock
+	: public counter<Timer, Time, Time>
+{
+public:
+	typedef counter<Timer, Time, Time> counter_type;
+	typedef Time time_type;
+
+	static const uint16_t prescaler = detail::clock_prescaler(Source);
+	static_assert(prescaler != 0, "unsupported clock source");
+
+	// Ticks corresponding to v microseconds, rounded to nearest
+	template <uint32_t v>
+	struct us
+	{
+		static const time_type value = time_type((uint64_t(v) * Fosc + uint64_t(prescaler) * 500000) / (uint64_t(prescaler) * 1000000));
+	};
+
+	// Ticks corresponding to v milliseconds, rounded to nearest
+	template <uint32_t v>
+	struct ms
+	{
+		static const time_type value = time_type((uint64_t(v) * Fosc + uint64_t(prescaler) * 500) / (uint64_t(prescaler) * 1000));
+	};
+
+	// Length of t ticks in real units, truncated
+	template <time_type t>
+	struct ticks
+	{
+		static const uint32_t us = uint32_t(uint64_t(t) * prescaler * 1000000 / Fosc);
+		static const uint32_t ms = uint32_t(uint64_t(t) * prescaler * 1000 / Fosc);
+	};
+
+	// The tick in real units as a reduced fraction, 64/1 us and 8/125 ms
+	// for the 1024 prescaler at 16MHz
+	static const uint32_t us_num = uint64_t(prescaler) * 1000000 / detail::gcd(uint64_t(prescaler) * 1000000, Fosc);
+	static const uint32_t us_den = Fosc / detail::gcd(uint64_t(prescaler) * 1000000, Fosc);
+	static const uint32_t ms_num = uint64_t(prescaler) * 1000 / detail::gcd(uint64_t(prescaler) * 1000, Fosc);
+	static const uint32_t ms_den = Fosc / detail::gcd(uint64_t(prescaler) * 1000, Fosc);
+
+	monotonic_clock()
+		: counter_type(Source)
+	{
+	}
+
+	// Length of t ticks in real units, truncated, for the reports; the
+	// timeouts are declared with us<> and ms<> instead.
+	static uint32_t to_us(time_type t)
+	{
+		return detail::scale<us_num, us_den>(t);
+	}
+
+	static uint32_t to_ms(time_type t)
+	{
+		return detail::scale<ms_num, ms_den>(t);
+	}
+};
+
+}
+
+#endif
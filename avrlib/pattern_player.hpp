@@ -0,0 +1,166 @@
+#ifndef AVRLIB_PATTERN_PLAYER_HPP
+#define AVRLIB_PATTERN_PLAYER_HPP
+
+#include <stdint.h>
+#include <avr/interrupt.h>
+
+namespace avrlib {
+
+// Plays queued on/off patterns on an Output from the compare-match interrupt
+// of a free-running Timer.
+//
+// Each step switches the output on with its argument for `on` ticks, off
+// for `off` ticks and does so `repeat` times. A step with zero `on` is a
+// rest. Successive edges are scheduled relative to the previous compare
+// point, so cadence does not depend on interrupt latency.
+//
+// The Output must provide set(arg_type) and clear(); intr() must be called
+// from the interrupt handler of the Compare unit.
+template <typename Timer, typename Compare, typename Output, uint8_t QueueSize = 8>
+class pattern_player
+{
+public:
+	typedef typename Timer::value_type time_type;
+	typedef typename Output::arg_type arg_type;
+
+	struct step
+	{
+		time_type on;
+		time_type off;
+		uint8_t repeat;
+		arg_type arg;
+	};
+
+	explicit pattern_player(Output & out)
+		: m_out(out), m_rptr(0), m_wptr(0), m_repeat(0), m_on(false), m_active(false)
+	{
+	}
+
+	// Queues a step. Returns false if the queue is full.
+	bool play(time_type on, time_type off, uint8_t repeat = 1, arg_type arg = arg_type())
+	{
+		step s = { on, off, repeat, arg };
+		return this->play(s);
+	}
+
+	bool play(step const & s)
+	{
+		cli();
+		uint8_t wptr = next(m_wptr);
+		bool res = wptr != m_rptr;
+		if (res)
+		{
+			m_queue[m_wptr] = s;
+			m_wptr = wptr;
+			if (!m_active)
+				this->kick();
+		}
+		sei();
+		return res;
+	}
+
+	// Queues a sequence of steps, e.g. a melody. Returns the number of steps
+	// that fit into the queue.
+	uint8_t play(step const * steps, uint8_t count)
+	{
+		uint8_t i = 0;
+		for (; i != count && this->play(steps[i]); ++i)
+		{
+		}
+		return i;
+	}
+
+	// Stops the current pattern and drops the queued ones.
+	void stop()
+	{
+		cli();
+		Compare::interrupt(false);
+		m_rptr = m_wptr;
+		m_repeat = 0;
+		m_on = false;
+		m_active = false;
+		m_out.clear();
+		sei();
+	}
+
+	bool active() const { return m_active; }
+
+	void intr()
+	{
+		time_type t = this->advance();
+		if (t != 0)
+			Compare::value(Compare::value() + t);
+		else
+			Compare::interrupt(false);
+	}
+
+private:
+	static uint8_t next(uint8_t i)
+	{
+		return i + 1 == QueueSize? 0: i + 1;
+	}
+
+	// Must be called with interrupts disabled.
+	void kick()
+	{
+		time_type t = this->advance();
+		if (t == 0)
+			return;
+		Compare::value(Timer::value() + t);
+		Compare::interrupt(true);
+	}
+
+	// Performs the edge that is due now and returns the number of ticks
+	// until the next one, or 0 when the queue is exhausted.
+	time_type advance()
+	{
+		for (;;)
+		{
+			if (m_on)
+			{
+				m_on = false;
+				m_out.clear();
+				if (m_current.off != 0)
+					return m_current.off;
+			}
+
+			if (m_repeat == 0)
+			{
+				if (m_rptr == m_wptr)
+				{
+					m_active = false;
+					return 0;
+				}
+				m_current = m_queue[m_rptr];
+				m_rptr = next(m_rptr);
+				m_repeat = m_current.repeat == 0? 1: m_current.repeat;
+			}
+
+			--m_repeat;
+			m_active = true;
+			if (m_current.on != 0)
+			{
+				m_out.set(m_current.arg);
+				m_on = true;
+				return m_current.on;
+			}
+			if (m_current.off != 0)
+				return m_current.off;
+		}
+	}
+
+	Output & m_out;
+
+	step m_queue[QueueSize];
+	volatile uint8_t m_rptr;
+	volatile uint8_t m_wptr;
+
+	step m_current;
+	uint8_t m_repeat;
+	bool m_on;
+	volatile bool m_active;
+};
+
+}
+
+#endif
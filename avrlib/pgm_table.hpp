@@ -0,0 +1,38 @@
+#ifndef AVRLIB_PGM_TABLE_HPP
+#define AVRLIB_PGM_TABLE_HPP
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+namespace avrlib {
+
+struct pgm_point
+{
+	uint16_t x;
+	uint16_t y;
+};
+
+// Linear interpolation in a flash table of points sorted by x. Values
+// outside of the table give the end points.
+inline uint16_t pgm_interpolate(pgm_point const * table, uint8_t size, uint16_t x)
+{
+	uint16_t x0 = pgm_read_word(&table[0].x);
+	uint16_t y0 = pgm_read_word(&table[0].y);
+	if (x <= x0)
+		return y0;
+
+	for (uint8_t i = 1; i != size; ++i)
+	{
+		uint16_t const x1 = pgm_read_word(&table[i].x);
+		uint16_t const y1 = pgm_read_word(&table[i].y);
+		if (x < x1)
+			return y0 + int16_t((int32_t(int32_t(y1) - y0) * (x - x0)) / (x1 - x0));
+		x0 = x1;
+		y0 = y1;
+	}
+	return y0;
+}
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef AVRLIB_PROFILER_HPP
+#define AVRLIB_PROFILER_HPP
+
+#include <stdint.h>
+#include "histogram.hpp"
+
+namespace avrlib {
+
+// Time spent in Sections sections of the code, read off Clock, a
+// free-running counter with a static value() that wraps at Clock::mask + 1.
+// Each section keeps the number of runs, the total, the extremes and a
+// log2 histogram of its durations in Clock units. A section must be
+// shorter than a wrap of the clock.
+template <typename Clock, uint8_t Sections, uint8_t Bins = 16>
+class section_profiler
+{
+public:
+	typedef uint32_t time_type;
+	typedef log2_histogram<time_type, Bins> stats;
+	static const uint8_t sections = Sections;
+
+	static time_type now() { return Clock::value(); }
+
+	void add(uint8_t section, time_type start)
+	{
+		m_stats[section].add((Clock::value() - start) & Clock::mask);
+	}
+
+	stats const & operator[](uint8_t section) const { return m_stats[section]; }
+
+	void clear()
+	{
+		for (uint8_t i = 0; i != Sections; ++i)
+			m_stats[i].clear();
+	}
+
+private:
+	stats m_stats[Sections];
+};
+
+// Adds the time from its construction to its destruction to the section.
+template <typename Profiler>
+class profile_scope
+{
+public:
+	profile_scope(Profiler & profiler, uint8_t section)
+		: m_profiler(profiler), m_section(section), m_start(Profiler::now())
+	{
+	}
+
+	~profile_scope()
+	{
+		m_profiler.add(m_section, m_start);
+	}
+
+private:
+	Profiler & m_profiler;
+	uint8_t m_section;
+	typename Profiler::time_type m_start;
+};
+
+}
+
+#endif
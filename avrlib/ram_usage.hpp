@@ -0,0 +1,75 @@
+#ifndef AVRLIB_RAM_USAGE_HPP
+#define AVRLIB_RAM_USAGE_HPP
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#ifndef AVRLIB_HOST
+extern "C" uint8_t __data_start;
+extern "C" uint8_t __heap_start;
+#endif
+
+namespace avrlib {
+
+// Stack painting: AVRLIB_PAINT_STACK() fills the RAM between the end of
+// the static data and the stack with stack_paint_byte from .init3, i.e.
+// before the static data is initialized. The bytes the stack has never
+// reached since keep the paint; their count is the margin left for the
+// stack over the run.
+//
+// Nothing is allocated from the heap, so the static data is followed by
+// free RAM up to the stack pointer.
+static const uint8_t stack_paint_byte = 0xc5;
+
+#ifndef AVRLIB_HOST
+
+// .data, .bss and .noinit
+inline uint16_t static_ram()
+{
+	return &__heap_start - &__data_start;
+}
+
+inline uint16_t stack_size()
+{
+	return RAMEND - SP;
+}
+
+inline uint16_t ram_free()
+{
+	return (uint8_t *)SP + 1 - &__heap_start;
+}
+
+// The low-water mark of the free RAM
+inline uint16_t stack_unused()
+{
+	uint8_t const * p = &__heap_start;
+	uint8_t const * const sp = (uint8_t const *)SP;
+	while (p <= sp && *p == stack_paint_byte)
+		++p;
+	return p - &__heap_start;
+}
+
+#define AVRLIB_PAINT_STACK() \
+	extern "C" void avrlib_paint_stack() __attribute__((naked, used, section(".init3"))); \
+	extern "C" void avrlib_paint_stack() \
+	{ \
+		for (uint8_t * p = &__heap_start; p < (uint8_t *)SP; ++p) \
+			*p = ::avrlib::stack_paint_byte; \
+	}
+
+#else
+
+// The host build keeps its data and its stack in the memory of the host,
+// there is nothing of the chip to measure.
+inline uint16_t static_ram() { return 0; }
+inline uint16_t stack_size() { return 0; }
+inline uint16_t ram_free() { return 0; }
+inline uint16_t stack_unused() { return 0; }
+
+#define AVRLIB_PAINT_STACK()
+
+#endif
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef AVRLIB_RESPONSE_CURVE_HPP
+#define AVRLIB_RESPONSE_CURVE_HPP
+
+#include <stdint.h>
+
+namespace avrlib {
+
+// Piecewise linear approximation of a response curve with a flat dead zone.
+//
+// The curve is constant over [dead_lo, dead_hi]; from there it runs through
+// Segments + 1 equidistant points to lo and to hi respectively and it
+// saturates beyond them. The points are computed once by build() from an
+// arbitrary function f; the evaluation costs one scaling multiplication,
+// one lookup and one interpolation.
+template <uint8_t Segments = 8>
+class response_curve
+{
+public:
+	static const uint8_t segments = Segments;
+	static const uint8_t points = Segments + 1;
+
+	response_curve()
+		: m_dead_lo(0), m_dead_hi(0), m_zero(0)
+	{
+		for (uint8_t i = 0; i != points; ++i)
+		{
+			m_lo.y[i] = 0;
+			m_hi.y[i] = 0;
+		}
+		m_lo.scale = 0;
+		m_hi.scale = 0;
+	}
+
+	// Requires lo <= dead_lo <= dead_hi <= hi; f takes an int32_t.
+	template <typename F>
+	void build(int16_t lo, int16_t dead_lo, int16_t dead_hi, int16_t hi, F f)
+	{
+		m_dead_lo = dead_lo;
+		m_dead_hi = dead_hi;
+		m_zero = f((int32_t(dead_lo) + dead_hi) / 2);
+		build_side(m_lo, dead_lo, int32_t(dead_lo) - lo, -1, f);
+		build_side(m_hi, dead_hi, int32_t(hi) - dead_hi, 1, f);
+	}
+
+	int16_t operator()(int16_t x) const
+	{
+		if (x > m_dead_hi)
+			return eval(m_hi, uint16_t(x - m_dead_hi));
+		if (x < m_dead_lo)
+			return eval(m_lo, uint16_t(m_dead_lo - x));
+		return m_zero;
+	}
+
+	int16_t dead_lo() const { return m_dead_lo; }
+	int16_t dead_hi() const { return m_dead_hi; }
+	int16_t zero() const { return m_zero; }
+	int16_t lo(uint8_t i) const { return m_lo.y[i]; }
+	int16_t hi(uint8_t i) const { return m_hi.y[i]; }
+
+private:
+	struct side
+	{
+		// Segments per input count, 8.8 bits
+		uint16_t scale;
+		int16_t y[points];
+	};
+
+	template <typename F>
+	static void build_side(side & s, int16_t edge, int32_t span, int8_t dir, F f)
+	{
+		if (span < 2 * Segments)
+			span = 2 * Segments;
+		s.scale = uint16_t((uint32_t(Segments) << 16) / uint32_t(span));
+		for (uint8_t i = 0; i != points; ++i)
+			s.y[i] = f(edge + dir * ((span * i + Segments / 2) / Segments));
+	}
+
+	static int16_t eval(side const & s, uint16_t d)
+	{
+		uint32_t u = (uint32_t(d) * s.scale) >> 8;
+		if (u >= (uint16_t(Segments) << 8))
+			return s.y[Segments];
+
+		uint8_t const i = u >> 8;
+		uint8_t const frac = u;
+		int16_t const y0 = s.y[i];
+		int32_t const dy = int32_t(s.y[i + 1]) - y0;
+		return y0 + int16_t((dy * frac) >> 8);
+	}
+
+	int16_t m_dead_lo;
+	int16_t m_dead_hi;
+	int16_t m_zero;
+	side m_lo;
+	side m_hi;
+};
+
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef AVRLIB_SCHEDULER_HPP
+#define AVRLIB_SCHEDULER_HPP
+
+#include <stdint.h>
+#include "monotonic_clock.hpp"
+
+namespace avrlib {
+
+// How the next release of a periodic task is derived.
+enum task_policy
+{
+	// One period after the task started; lateness accumulates as drift.
+	task_restart,
+	// One period after the previous deadline, like timeout::ack(); releases
+	// missed while the task was late run back to back.
+	task_catch_up,
+	// One period after the previous deadline, but releases that are already
+	// in the past are dropped, keeping the phase.
+	task_skip
+};
+
+// Cooperative earliest-deadline-first scheduler over a task table that is
+// fixed at compile time.
+//
+// Periodic tasks are released according to their task_policy; a task
+// with a zero period is always due and is released again right after it
+// runs, so such background tasks take turns with the periodic ones in the
+// order of their deadlines. Tasks can be suspended and later resumed with
+// a one-shot deadline.
+//
+// A task may also be gated by a ready() predicate, typically testing for
+// data queued by an interrupt handler; it is skipped while the predicate
+// is false. When run_once() finds nothing to do, the caller may sleep until
+// next_deadline() or until an interrupt makes pending() true.
+template <typename Timer, uint8_t N>
+class scheduler
+{
+public:
+	typedef typename Timer::time_type time_type;
+	typedef void (*function_type)();
+	typedef bool (*predicate_type)();
+	static const uint8_t size = N;
+
+	struct task
+	{
+		char const * name;
+		function_type run;
+		time_type period;
+		task_policy policy;
+		predicate_type ready;
+	};
+
+	struct stats
+	{
+		uint32_t runs;
+		uint16_t overruns;
+		time_type max_jitter;
+		time_type wcet;
+	};
+
+	scheduler(Timer const & timer, task const (&tasks)[N])
+		: m_timer(timer), m_tasks(tasks)
+	{
+		for (uint8_t i = 0; i != N; ++i)
+		{
+			m_period[i] = m_tasks[i].period;
+			m_deadline[i] = 0;
+			m_suspended[i] = false;
+		}
+		this->clear_stats();
+	}
+
+	// Releases all tasks that are not suspended at the current time.
+	void start()
+	{
+		time_type now = m_timer();
+		for (uint8_t i = 0; i != N; ++i)
+			m_deadline[i] = now;
+	}
+
+	// Runs the due task with the earliest deadline. Returns false if no task
+	// was due.
+	bool run_once()
+	{
+		time_type now = m_timer();
+
+		uint8_t next = N;
+		for (uint8_t i = 0; i != N; ++i)
+		{
+			if (m_suspended[i] || time_after(m_deadline[i], now))
+				continue;
+			if (m_tasks[i].ready && !m_tasks[i].ready())
+				continue;
+			if (next == N || time_before(m_deadline[i], m_deadline[next]))
+				next = i;
+		}
+
+		if (next == N)
+			return false;
+
+		time_type const period = m_period[next];
+		time_type const jitter = now - m_deadline[next];
+		task_policy const policy = m_tasks[next].policy;
+		uint16_t missed = 0;
+
+		// The deadline is updated first, so that the task may reschedule itself.
+		if (period == 0 || policy == task_restart)
+		{
+			m_deadline[next] = now + period;
+		}
+		else
+		{
+			m_deadline[next] += period;
+			while (policy == task_skip && time_before(m_deadline[next], now))
+			{
+				m_deadline[next] += period;
+				++missed;
+			}
+		}
+
+		m_tasks[next].run();
+		time_type const elapsed = m_timer() - now;
+
+		stats & st = m_stats[next];
+		++st.runs;
+		if (jitter > st.max_jitter)
+			st.max_jitter = jitter;
+		if (elapsed > st.wcet)
+			st.wcet = elapsed;
+		if (missed == 0 && period != 0 && (jitter >= period || elapsed > period))
+			missed = 1;
+		st.overruns += missed;
+		return true;
+	}
+
+	// Gets the earliest deadline of the tasks that are not gated by a ready()
+	// predicate. Returns false if there is no such task.
+	bool next_deadline(time_type & deadline) const
+	{
+		bool found = false;
+		for (uint8_t i = 0; i != N; ++i)
+		{
+			if (m_suspended[i] || m_tasks[i].ready)
+				continue;
+			if (!found || time_before(m_deadline[i], deadline))
+				deadline = m_deadline[i];
+			found = true;
+		}
+		return found;
+	}
+
+	// Tests whether any gated task has become ready. Only the predicates are
+	// evaluated, so this is safe to call with interrupts disabled.
+	bool pending() const
+	{
+		for (uint8_t i = 0; i != N; ++i)
+		{
+			if (!m_suspended[i] && m_tasks[i].ready && m_tasks[i].ready())
+				return true;
+		}
+		return false;
+	}
+
+	void suspend(uint8_t i)
+	{
+		m_suspended[i] = true;
+	}
+
+	void resume(uint8_t i, time_type delay = 0)
+	{
+		m_deadline[i] = m_timer() + delay;
+		m_suspended[i] = false;
+	}
+
+	bool suspended(uint8_t i) const { return m_suspended[i]; }
+
+	time_type period(uint8_t i) const { return m_period[i]; }
+	void period(uint8_t i, time_type value) { m_period[i] = value; }
+
+	time_type deadline(uint8_t i) const { return m_deadline[i]; }
+
+	char const * name(uint8_t i) const { return m_tasks[i].name; }
+
+	stats const & get_stats(uint8_t i) const { return m_stats[i]; }
+
+	void clear_stats()
+	{
+		for (uint8_t i = 0; i != N; ++i)
+		{
+			m_stats[i].runs = 0;
+			m_stats[i].overruns = 0;
+			m_stats[i].max_jitter = 0;
+			m_stats[i].wcet = 0;
+		}
+	}
+
+private:
+	Timer const & m_timer;
+	task const * m_tasks;
+
+	time_type m_period[N];
+	time_type m_deadline[N];
+	bool m_suspended[N];
+	stats m_stats[N];
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef AVRLIB_SEQLOCK_HPP
+#define AVRLIB_SEQLOCK_HPP
+
+#include <stdint.h>
+
+// Keeps the compiler from moving memory accesses across this point
+#define avrlib_compiler_barrier() asm volatile ("":::"memory")
+
+namespace avrlib {
+
+// Double buffer with a single writer, guarded by a sequence counter.
+//
+// The writer, typically an interrupt handler, fills back() and calls
+// publish(), which flips the buffers; the lowest bit of the counter
+// selects the published one. A reader copies the published buffer and
+// retries if the counter changed in the meantime. The writer never
+// waits and the reader never sees a torn value; a retry is only needed
+// if the reader was preempted until the next publish.
+template <typename T>
+class seqlock
+{
+public:
+	typedef T value_type;
+
+	seqlock()
+		: m_seq(0)
+	{
+	}
+
+	// The buffer to be filled by the writer.
+	value_type & back() { return m_buffers[(m_seq + 1) & 1]; }
+
+	void publish()
+	{
+		avrlib_compiler_barrier();
+		++m_seq;
+	}
+
+	void publish(value_type const & v)
+	{
+		this->back() = v;
+		this->publish();
+	}
+
+	// Incremented on each publish.
+	uint8_t sequence() const { return m_seq; }
+
+	void read(value_type & v) const
+	{
+		uint8_t seq;
+		do
+		{
+			seq = m_seq;
+			avrlib_compiler_barrier();
+			v = m_buffers[seq & 1];
+			avrlib_compiler_barrier();
+		}
+		while (seq != m_seq);
+	}
+
+	value_type read() const
+	{
+		value_type v;
+		this->read(v);
+		return v;
+	}
+
+private:
+	value_type m_buffers[2];
+	volatile uint8_t m_seq;
+};
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef AVRLIB_TIMER0_HPP
+#define AVRLIB_TIMER0_HPP
+
+#include <avr/io.h>
+#include "timer_base.hpp"
+
+#ifndef TCCR0B
+# define TCCR0B TCCR0
+#endif
+
+#ifndef TIFR0
+# define TIFR0 TIFR
+#endif
+
+#ifndef TIMSK0
+# define TIMSK0 TIMSK
+#endif
+
+#ifndef OCR0A
+# define OCR0A OCR0
+#endif
+
+#ifndef OCIE0A
+# define OCIE0A OCIE0
+#endif
+
+#ifndef OCF0A
+# define OCF0A OCF0
+#endif
+
+namespace avrlib {
+
+struct timer0
+{
+	typedef uint8_t value_type;
+	typedef value_type time_type;
+	static const uint8_t value_bits = 8;
+
+	static value_type value()
+	{
+		return TCNT0;
+	}
+
+	static void value(value_type v)
+	{
+		TCNT0 = v;
+	}
+
+	static void clock_source(timer_clock_source v)
+	{
+#ifdef AS0
+		// The asynchronous timer0 has its own prescaler with /32 and /128 taps
+		static uint8_t const cs[] = { 0, 1, 2, 4, 6, 7, 0, 0 };
+		TCCR0B = (TCCR0B & 0xf8) | cs[v];
+#else
+		TCCR0B = (TCCR0B & 0xf8) | v;
+#endif
+	}
+
+	static uint8_t clock_source() { return TCCR0B & 0x07; }
+
+	static value_type top()
+	{
+		return timer_top_8b;
+	}
+
+	struct ocra
+	{
+		static void value(value_type v) { OCR0A = v; }
+		static value_type value() { return OCR0A; }
+		static void interrupt(bool enable)
+		{
+			if (enable)
+			{
+				TIFR0 = (1<<OCF0A);
+				TIMSK0 |= (1<<OCIE0A);
+			}
+			else
+				TIMSK0 &= ~(1<<OCIE0A);
+		}
+		static bool matched() { return TIFR0 & (1<<OCF0A); }
+		static void clear_matched() { TIFR0 = (1<<OCF0A); }
+	};
+
+	static void tov_interrupt(bool v)
+	{
+		if (v)
+		{
+			TIFR0 = (1<<TOV0);
+			TIMSK0 |= (1<<TOIE0);
+		}
+		else
+			TIMSK0 &= ~(1<<TOIE0);
+	}
+
+	static bool overflow()
+	{
+		return TIFR0 & (1<<TOV0);
+	}
+
+	static void clear_overflow()
+	{
+		TIFR0 = (1<<TOV0);
+	}
+};
+
+}
+
+#endif
@@ -103,7 +103,7 @@ struct timer1
 				TIMSK1 |= (1<<OCIE1A);
 			}
 			else
-				TIMSK1 &= (1<<OCIE1A);
+				TIMSK1 &= ~(1<<OCIE1A);
 		}
 		static bool matched() { return TIFR1 & (1<<OCF1A); }
 		static void clear_matched() { TIFR1 = (1<<OCF1A); }
@@ -123,7 +123,7 @@ struct timer1
 				TIMSK1 |= (1<<OCIE1B);
 			}
 			else
-				TIMSK1 &= (1<<OCIE1B);
+				TIMSK1 &= ~(1<<OCIE1B);
 		}
 		static bool matched() { return TIFR1 & (1<<OCF1B); }
 		static void clear_matched() { TIFR1 = (1<<OCF1B); }
@@ -146,7 +146,7 @@ struct timer1
 				TIMSK1 |= (1<<OCIE1C);
 			}
 			else
-				TIMSK1 &= (1<<OCIE1C);
+				TIMSK1 &= ~(1<<OCIE1C);
 		}
 #else
 		static void interrupt(bool enable)
@@ -157,7 +157,7 @@ struct timer1
 				ETIMSK |= (1<<OCIE1C);
 			}
 			else
-				ETIMSK &= (1<<OCIE1C);
+				ETIMSK &= ~(1<<OCIE1C);
 		}
 		static bool matched() { return TIFR1 & (1<<OCF1B); }
 		static void clear_matched() { TIFR1 = (1<<OCF1B); }
@@ -188,7 +188,7 @@ struct timer1
 				TIMSK1 |= (1<<ICIE1);
 			}
 			else
-				TIMSK1 &= (1<<ICIE1);
+				TIMSK1 &= ~(1<<ICIE1);
 		}
 
 		static bool captured()
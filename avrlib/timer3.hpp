@@ -102,7 +102,7 @@ struct timer3
 				TIMSK3 |= (1<<OCIE3A);
 			}
 			else
-				TIMSK3 &= (1<<OCIE3A);
+				TIMSK3 &= ~(1<<OCIE3A);
 		}
 		static bool matched() { return TIFR3 & (1<<OCF3A); }
 		static void clear_matched() { TIFR3 = (1<<OCF3A); }
@@ -123,7 +123,7 @@ struct timer3
 				TIMSK3 |= (1<<OCIE3B);
 			}
 			else
-				TIMSK3 &= (1<<OCIE3B);
+				TIMSK3 &= ~(1<<OCIE3B);
 		}
 		static bool matched() { return TIFR3 & (1<<OCF3B); }
 		static void clear_matched() { TIFR3 = (1<<OCF3B); }
@@ -145,7 +145,7 @@ struct timer3
 				TIMSK3 |= (1<<OCIE3C);
 			}
 			else
-				TIMSK3 &= (1<<OCIE3C);
+				TIMSK3 &= ~(1<<OCIE3C);
 		}
 		static bool matched() { return TIFR3 & (1<<OCF3C); }
 		static void clear_matched() { TIFR3 = (1<<OCF3C); }
@@ -175,7 +175,7 @@ struct timer3
 				TIMSK3 |= (1<<ICIE3);
 			}
 			else
-				TIMSK3 &= (1<<ICIE3);
+				TIMSK3 &= ~(1<<ICIE3);
 		}
 
 		static bool captured()
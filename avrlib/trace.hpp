@@ -0,0 +1,156 @@
+#ifndef AVRLIB_TRACE_HPP
+#define AVRLIB_TRACE_HPP
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "format.hpp"
+
+namespace avrlib {
+
+// Event 0 is a gap: a delta too long for a record is split into a gap,
+// whose arg holds the upper 16 bits, and the event itself.
+static const uint8_t trace_gap = 0;
+
+struct trace_record
+{
+	uint16_t dt;    // clock ticks since the previous record
+	uint8_t id;
+	uint16_t arg;
+};
+
+// Ring of the Capacity latest events, each with its time since the
+// previous one in ticks of Clock. An append reads the clock and stores a
+// record; the oldest record is overwritten when the ring is full.
+//
+// The events are added by add(), which leaves the interrupt flag as it
+// was and so works anywhere, e.g. in main() before sei(), or by the
+// cheaper add_nointr() from the handlers. While paused, e.g. for a dump,
+// the events are counted as lost instead.
+template <typename Clock, uint8_t Capacity>
+class trace_ring
+{
+	static_assert(Capacity <= 127, "the indices of the ring are bytes");
+
+public:
+	typedef typename Clock::time_type time_type;
+	typedef trace_record record;
+	static const uint8_t capacity = Capacity;
+
+	explicit trace_ring(Clock const & clock)
+		: m_clock(clock), m_last(0), m_head(0), m_size(0), m_paused(false), m_lost(0)
+	{
+	}
+
+	void add(uint8_t id, uint16_t arg = 0)
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		this->add_nointr(id, arg);
+		SREG = sreg;
+	}
+
+	void add_nointr(uint8_t id, uint16_t arg = 0)
+	{
+		if (m_paused)
+		{
+			++m_lost;
+			return;
+		}
+
+		time_type const now = m_clock.value_nointr();
+		time_type const dt = now - m_last;
+		m_last = now;
+		if (dt > 0xffff)
+		{
+			this->push(uint16_t(dt), trace_gap, uint16_t(dt >> 16));
+			this->push(0, id, arg);
+		}
+		else
+		{
+			this->push(uint16_t(dt), id, arg);
+		}
+	}
+
+	void pause(bool paused) { m_paused = paused; }
+
+	uint8_t size() const { return m_size; }
+
+	// The record i, 0 being the oldest; pause() the ring while reading.
+	record const & operator[](uint8_t i) const
+	{
+		uint8_t j = m_head + (Capacity - m_size) + i;
+		if (j >= Capacity)
+			j -= Capacity;
+		return m_records[j];
+	}
+
+	// The time of the newest record
+	time_type last() const { return m_last; }
+	Clock const & clock() const { return m_clock; }
+	uint16_t lost() const { return m_lost; }
+
+	void clear()
+	{
+		m_size = 0;
+		m_lost = 0;
+	}
+
+private:
+	void push(uint16_t dt, uint8_t id, uint16_t arg)
+	{
+		record & r = m_records[m_head];
+		r.dt = dt;
+		r.id = id;
+		r.arg = arg;
+		if (++m_head == Capacity)
+			m_head = 0;
+		if (m_size != Capacity)
+			++m_size;
+	}
+
+	Clock const & m_clock;
+	time_type m_last;
+	record m_records[Capacity];
+	uint8_t m_head;
+	uint8_t m_size;
+	volatile bool m_paused;
+	uint16_t m_lost;
+};
+
+static const uint8_t trace_dump_version = 1;
+
+// Sends the records in binary, little-endian, for a host-side decoder:
+//
+//   'T' 'R' 'C' version
+//   uint8_t count, uint16_t lost, uint32_t last, uint32_t now, uint32_t tick_ns
+//   count records of uint16_t dt, uint8_t id, uint16_t arg, oldest first
+//
+// last is the time of the newest record and now the time of the dump, both
+// in ticks since the clock started. The ring is paused while sending.
+template <typename Stream, typename Ring>
+void send_trace(Stream & s, Ring & ring, uint32_t tick_ns)
+{
+	ring.pause(true);
+	s.write('T');
+	s.write('R');
+	s.write('C');
+	s.write(trace_dump_version);
+	send_bin(s, ring.size());
+	send_bin(s, ring.lost());
+	send_bin(s, uint32_t(ring.last()));
+	send_bin(s, uint32_t(ring.clock().value()));
+	send_bin(s, tick_ns);
+	for (uint8_t i = 0; i != ring.size(); ++i)
+	{
+		trace_record const & r = ring[i];
+		send_bin(s, r.dt);
+		send_bin(s, r.id);
+		send_bin(s, r.arg);
+	}
+	ring.pause(false);
+}
+
+}
+
+#endif
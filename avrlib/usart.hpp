@@ -27,7 +27,7 @@ public:
 		this->open(ubrr, rx_interrupt);
 	}
 
-	usart(uint32_t speed, bool rx_interrupt = false)
+	usart(unsigned long speed, bool rx_interrupt = false)
 	{
 		this->open(speed, rx_interrupt);
 	}
@@ -37,7 +37,7 @@ public:
 		UCSRB = 0;
 	}
 
-	void open(uint32_t speed, bool rx_interrupt = false)
+	void open(unsigned long speed, bool rx_interrupt = false)
 	{
 		uint16_t ubrr = detail::get_ubrr(speed);
 		this->open(ubrr, rx_interrupt);
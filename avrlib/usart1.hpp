@@ -30,7 +30,7 @@ public:
 		this->open(ubrr, rx_interrupt);
 	}
 	
-	usart1(uint32_t speed, bool rx_interrupt = false)
+	usart1(unsigned long speed, bool rx_interrupt = false)
 	{
 		this->open(speed, rx_interrupt);
 	}
@@ -40,7 +40,7 @@ public:
 		this->close();
 	}
 
-	void open(uint32_t speed, bool rx_interrupt = false)
+	void open(unsigned long speed, bool rx_interrupt = false)
 	{
 		uint16_t ubrr = detail::get_ubrr(speed);
 		this->open(ubrr, rx_interrupt);
@@ -81,8 +81,10 @@ public:
 		UCSR1B = 0;
 	}
 
+	// Clears TXC, so that tx_done() tracks the last byte sent.
 	void send(value_type v)
 	{
+		UCSR1A |= (1<<TXC1);
 		UDR1 = v;
 	}
 
@@ -116,6 +118,12 @@ public:
 		return (UCSR1A & (1<<UDRE1)) != 0;
 	}
 
+	// The last byte sent has been shifted out; false until the first one is.
+	bool tx_done() const
+	{
+		return (UCSR1A & (1<<TXC1)) != 0;
+	}
+
 	bool transmitted()
 	{
 		if((UCSR1A & (1<<TXC1)) == 0)
@@ -57,7 +57,21 @@ inv_pin<porte, 6> sw5;
 pin    <portb, 2> sw6;
 pin    <portb, 3> sw7;
 
-static const uint8_t adc_channels = 5;
+// All switches from one read of PINE and PINB, switch i from the i-th
+// listed bit; sw1-sw5 are active low.
+inline uint8_t read_switches()
+{
+	uint8_t const e = bit_gather<2, 3, 4, 5, 7, 6>::apply(porte::pin());
+	uint8_t const b = bit_gather<no_bit, no_bit, no_bit, no_bit, no_bit, no_bit, 2, 3>::apply(portb::pin());
+	return (e | b) ^ 0x3e;
+}
+
+// Analog inputs in the order of the scan and the roles of the switches
+typedef channel_map<channel_axis, channel_axis, channel_axis, channel_axis,
+	channel_battery> analog_inputs;
+typedef switch_map<4, 7, 6, 5, 4> digital_inputs;
+
+static const uint8_t adc_channels = analog_inputs::size;
 
 async_adc adcs[adc_channels] = {
 	async_adc(1, true , false),
@@ -69,6 +83,18 @@ async_adc adcs[adc_channels] = {
 
 static const uint16_t low_battery_threshold = 39322;
 
+// State of charge in permille over the battery reading, for four NiMH
+// cells with low_battery_threshold at 1.10V per cell
+static const pgm_point battery_soc_table[] PROGMEM = {
+	{ 35747,    0 }, // 1.00V
+	{ 39322,   50 }, // 1.10V
+	{ 41110,  100 }, // 1.15V
+	{ 42898,  300 }, // 1.20V
+	{ 44685,  700 }, // 1.25V
+	{ 46472,  900 }, // 1.30V
+	{ 48260, 1000 }  // 1.35V
+};
+
 void hw_init()
 {
 	sw0.pullup();
@@ -64,7 +64,18 @@ pin<portb, 4> sw5;
 pin<portb, 2> sw6;
 pin<portb, 0> sw7;
 
-static const uint8_t adc_channels = 5;
+// All switches from one read of PINB, switch i from the i-th listed bit
+inline uint8_t read_switches()
+{
+	return bit_gather<1, 3, 5, 7, 6, 4, 2, 0>::apply(portb::pin());
+}
+
+// Analog inputs in the order of the scan and the roles of the switches
+typedef channel_map<channel_axis, channel_axis, channel_axis, channel_axis,
+	channel_battery> analog_inputs;
+typedef switch_map<4, 7, 6, 5, 4> digital_inputs;
+
+static const uint8_t adc_channels = analog_inputs::size;
 
 async_adc adcs[adc_channels] = {
 	async_adc(4, true , false),
@@ -76,6 +87,18 @@ async_adc adcs[adc_channels] = {
 
 static const uint16_t low_battery_threshold = 39322;
 
+// State of charge in permille over the battery reading, for four NiMH
+// cells with low_battery_threshold at 1.10V per cell
+static const pgm_point battery_soc_table[] PROGMEM = {
+	{ 35747,    0 }, // 1.00V
+	{ 39322,   50 }, // 1.10V
+	{ 41110,  100 }, // 1.15V
+	{ 42898,  300 }, // 1.20V
+	{ 44685,  700 }, // 1.25V
+	{ 46472,  900 }, // 1.30V
+	{ 48260, 1000 }  // 1.35V
+};
+
 void hw_init()
 {
 	DDRB = 0;
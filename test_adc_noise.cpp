@@ -0,0 +1,214 @@
+// The noise of the raw readings with and without ADC noise reduction, as
+// the 'v' and 'V' commands measure it through the real idle().
+//
+// The samples replay a log: for every channel and conversion, the analog
+// noise of the input and the digital noise of the running CPU, drawn from
+// a fixed seed. The digital noise is coupled in by the share of the
+// conversion the CPU was not in a sleep that halts the I/O clock, so the
+// mode only changes which part of the same log reaches the readings. Each
+// channel has to read quieter in the noise reduction sleep.
+//
+// In that mode the system timer has to keep up with the time the sleeps
+// halt it for, and INT2 may wake the CPU up at most once per byte received,
+// though every falling edge of RXD1 sets its flag.
+
+#include "test_harness.hpp"
+#include "avrlib/host/bench.hpp"
+
+using namespace harness;
+
+static const uint16_t log_size = 1024;
+static const int8_t analog_noise = 1;
+static const int8_t digital_noise = 8;
+
+// The scans of 'v' take at most 133ms at 5 channels.
+static const cycle_t measure_cycles = F_CPU / 2;
+static const cycle_t drift_cycles = 2 * F_CPU;
+
+// The console takes a character for a new command only after 128ms
+// without input, so the next command waits that long after the reply to
+// the previous one.
+static const cycle_t command_gap = F_CPU / 5;
+
+struct noise_log
+{
+	int8_t analog[8][log_size];
+	int8_t digital[8][log_size];
+	uint16_t pos[8];
+};
+
+noise_log replay;
+
+uint16_t sample(uint8_t channel)
+{
+	uint16_t & pos = replay.pos[channel];
+	int32_t const awake = avrlib::host::adc_awake_cycles();
+	int32_t const coupled = replay.digital[channel][pos] * (awake < adc_conversion_cycles? awake: adc_conversion_cycles) / adc_conversion_cycles;
+	uint16_t const res = 512 + replay.analog[channel][pos] + coupled;
+	pos = (pos + 1) % log_size;
+	return res;
+}
+
+void record_log()
+{
+	avrlib::host::bench_random rnd;
+	for (uint8_t i = 0; i != 8; ++i)
+	{
+		for (uint16_t j = 0; j != log_size; ++j)
+		{
+			replay.analog[i][j] = int8_t(rnd() % (2 * analog_noise + 1)) - analog_noise;
+			replay.digital[i][j] = int8_t(rnd() % (2 * digital_noise + 1)) - digital_noise;
+		}
+	}
+}
+
+// The variances of 'V' in hundredths of a count
+uint32_t variance[2][adc_channels];
+
+enum phase { phase_silent, phase_measure, phase_report, phase_mode, phase_drift, phase_idle_report };
+
+phase current = phase_silent;
+uint8_t mode = 0;
+size_t phase_start = 0;
+cycle_t phase_time = 0;
+cycle_t reply_time = 0;
+bool reported = false;
+cycle_t drift_start = 0;
+uint32_t int2_start = 0;
+uint32_t received_start = 0;
+
+bool replied(bool complete)
+{
+	if (!complete)
+		return false;
+	if (reply_time == 0)
+		reply_time = cycles();
+	return cycles() - reply_time >= command_gap;
+}
+
+void next_phase(phase p, char const * input)
+{
+	type(input);
+	current = p;
+	phase_start = output_len();
+	phase_time = cycles();
+	reply_time = 0;
+	reported = false;
+}
+
+bool parse_report()
+{
+	long const head = find("256scans, noise reduction ", phase_start);
+	if (head < 0)
+		return false;
+	char const * p = output() + head;
+	char const * const end = output() + output_len();
+	uint8_t lines = 0;
+	for (char const * q = p; q != end; ++q)
+		lines += *q == '\n';
+	if (lines != 1 + adc_channels)
+		return false;
+
+	for (uint8_t i = 0; i != adc_channels; ++i)
+	{
+		p = (char const *)memchr(p, '\n', end - p) + 1;
+		unsigned ch, mean, var;
+		if (!TEST_CHECK(sscanf(p, "%u\t%u\t%u", &ch, &mean, &var) == 3 && ch == i))
+			return true;
+		variance[mode][i] = var;
+	}
+	return true;
+}
+
+void check_variance()
+{
+	for (uint8_t i = 0; i != adc_channels; ++i)
+	{
+		printf("channel %u: variance %u.%02u idle, %u.%02u noise reduction\n", i,
+			variance[0][i] / 100, variance[0][i] % 100, variance[1][i] / 100, variance[1][i] % 100);
+		// 0.67 of the analog noise against 24 of the digital one, scaled
+		// by 4096 on the left adjusted battery channel
+		TEST_CHECK(variance[1][i] * 4 < variance[0][i]);
+	}
+}
+
+void check_drift()
+{
+	long const at = find("total ", phase_start);
+	unsigned long total_us;
+	if (!TEST_CHECK(sscanf(output() + at, "total %lu us", &total_us) == 1))
+		return;
+	uint64_t const elapsed_us = (cycles() - drift_start) / (F_CPU / 1000000);
+	printf("system timer %lu us over %lu us\n", total_us, (unsigned long)elapsed_us);
+	TEST_CHECK(total_us * 100 > elapsed_us * 99 && total_us * 100 < elapsed_us * 101);
+
+	avrlib::host::machine const & m = avrlib::host::mcu();
+	uint32_t const int2 = m.vector_interrupts[INT2_vect_num] - int2_start;
+	uint32_t const received = m.usart[1].received - received_start;
+	printf("%lu INT2 interrupts for %lu bytes\n", (unsigned long)int2, (unsigned long)received);
+	TEST_CHECK(int2 != 0 && int2 <= received);
+}
+
+void step()
+{
+	switch (current)
+	{
+	case phase_silent:
+		if (!replied(find("silent\n") >= 0))
+			break;
+		memset(replay.pos, 0, sizeof replay.pos);
+		next_phase(phase_measure, "v");
+		break;
+
+	case phase_measure:
+		if (cycles() - phase_time >= measure_cycles)
+			next_phase(phase_report, "V");
+		break;
+
+	case phase_report:
+		if (!reported)
+			reported = parse_report();
+		if (!replied(reported))
+			break;
+		if (mode == 1)
+		{
+			check_variance();
+			next_phase(phase_idle_report, "i");
+			break;
+		}
+		mode = 1;
+		next_phase(phase_mode, "z");
+		break;
+
+	case phase_mode:
+		if (!replied(find("ADC noise reduction on\n", phase_start) >= 0))
+			break;
+		drift_start = cycles();
+		int2_start = avrlib::host::mcu().vector_interrupts[INT2_vect_num];
+		received_start = avrlib::host::mcu().usart[1].received;
+		next_phase(phase_drift, "I");
+		break;
+
+	case phase_drift:
+		if (cycles() - drift_start < drift_cycles)
+			break;
+		memset(replay.pos, 0, sizeof replay.pos);
+		next_phase(phase_measure, "v");
+		break;
+
+	case phase_idle_report:
+		if (find(" sleeps", phase_start) < 0)
+			break;
+		check_drift();
+		finish();
+		break;
+	}
+}
+
+int main()
+{
+	record_log();
+	avrlib::host::adc_source(&sample);
+	type("0");
+	return run("adc_noise", &step, 10);
+}
@@ -0,0 +1,117 @@
+// The address book of the older firmware converted in the background. The
+// console has to answer right after the boot, with the converted targets
+// already in the index, and the records and the header have to be in the
+// EEPROM once the migration has been written out.
+
+#include "test_harness.hpp"
+
+using namespace harness;
+
+// Away from slot 9, which the target switch of the model selects and the
+// boot would connect to with its guard times
+struct legacy_target
+{
+	uint8_t slot;
+	uint8_t mac[6];
+};
+
+static legacy_target const targets[] = {
+	{ 0,  { 0x00, 0x80, 0x37, 0x1b, 0x2c, 0x01 } },
+	{ 5,  { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 } },
+	{ 63, { 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 } }
+};
+
+static const uint8_t target_count = sizeof targets / sizeof targets[0];
+
+// The boot waits 0.5s for its melody.
+static const cycle_t answer_cycles = F_CPU;
+
+// 64 records of 20 bytes and the header at 8.5ms a byte, with the gaps of
+// the steps
+static const cycle_t migration_cycles = 14 * F_CPU;
+
+enum phase { phase_boot, phase_migration };
+
+phase current = phase_boot;
+
+legacy_target const * target(uint8_t slot)
+{
+	for (uint8_t i = 0; i != target_count; ++i)
+	{
+		if (targets[i].slot == slot)
+			return &targets[i];
+	}
+	return 0;
+}
+
+void check_index()
+{
+	for (uint8_t i = 0; i != address_book_t::size; ++i)
+	{
+		legacy_target const * t = target(i);
+		if (!TEST_CHECK(book.status(i) == (t? address_book_t::valid: address_book_t::empty)))
+			fprintf(stderr, "  slot %u\n", i);
+		if (t != 0)
+		{
+			TEST_CHECK(memcmp(book.mac(i), t->mac, 6) == 0);
+			TEST_CHECK(book.protocol(i) == i / 8 + 1);
+			TEST_CHECK(book.flags(i) == address_book_t::flag_migrated);
+		}
+	}
+}
+
+void check_eeprom()
+{
+	uint8_t const * p = avrlib::host::eeprom() + book_eeprom_offset;
+	TEST_CHECK(p[0] == 'Y' && p[1] == 'B' && p[2] == address_book_t::version);
+	for (uint8_t i = 0; i != address_book_t::size; ++i)
+	{
+		address_book_t::record r;
+		memcpy(&r, p + address_book_t::header_size + i * sizeof r, sizeof r);
+		legacy_target const * t = target(i);
+		if (t == 0)
+		{
+			TEST_CHECK(r.version == 0xff);
+			continue;
+		}
+		if (!TEST_CHECK(r.version == address_book_t::version && memcmp(r.mac, t->mac, 6) == 0))
+			fprintf(stderr, "  slot %u\n", i);
+		TEST_CHECK(r.flags == address_book_t::flag_migrated);
+	}
+}
+
+void step()
+{
+	switch (current)
+	{
+	case phase_boot:
+		if (find("silent\n") < 0)
+			break;
+		TEST_CHECK(cycles() < answer_cycles);
+		TEST_CHECK(book.migrating());
+		check_index();
+		current = phase_migration;
+		break;
+
+	case phase_migration:
+		if (cycles() < migration_cycles)
+			break;
+		TEST_CHECK(!book.migrating());
+		check_index();
+		check_eeprom();
+		finish();
+		break;
+	}
+}
+
+int main()
+{
+	uint8_t * e = avrlib::host::eeprom();
+	for (uint8_t i = 0; i != address_book_t::size; ++i)
+		memset(e + addr_eeprom_offset + 6 * i, i % 2? 0: 0xff, 6);
+	for (uint8_t i = 0; i != target_count; ++i)
+		memcpy(e + addr_eeprom_offset + 6 * targets[i].slot, targets[i].mac, 6);
+
+	type("0");
+	return run("book_migration", &step, 20);
+}
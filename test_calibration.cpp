@@ -0,0 +1,110 @@
+// The 'C' command from start to end. The settle loop of the command only
+// polls the inputs the ADC interrupt publishes, so the model has to take
+// the interrupts while it spins. The axes are held centered, then moved
+// to both ends, and the calibration has to match them.
+
+#include "test_harness.hpp"
+
+using namespace harness;
+
+static const uint16_t low = 100;
+static const uint16_t high = 900;
+static const uint8_t rows_per_end = 40;
+
+enum phase { phase_center, phase_range, phase_done };
+
+phase current = phase_center;
+long range_start = 0;
+cycle_t center_time = 0;
+cycle_t range_time = 0;
+
+void set_axes(uint16_t v)
+{
+	for (uint8_t i = 0; i != input_axes; ++i)
+		avrlib::host::adc_input(adcs[i].channel(), v);
+}
+
+// The rows of the range phase printed so far
+uint16_t rows()
+{
+	uint16_t res = 0;
+	for (long i = find("\r\n", range_start); i >= 0; i = find("\r\n", i + 2))
+		++res;
+	return res;
+}
+
+void check_calibration()
+{
+	config_t const & c = config.get();
+	for (uint8_t i = 0; i != input_axes; ++i)
+	{
+		// the reversed inputs read negated
+		bool const rev = adcs[i].reverse();
+		int16_t const center = rev? -512: 512;
+		int16_t const lo = (rev? -int16_t(high): int16_t(low)) - center;
+		int16_t const hi = (rev? -int16_t(low): int16_t(high)) - center;
+
+		TEST_CHECK(c.adc_offset[i] == center);
+		TEST_CHECK(c.adc_gain_neg[i].get_raw() == full_scale_gain(-lo).get_raw());
+		TEST_CHECK(c.adc_gain_pos[i].get_raw() == full_scale_gain(hi).get_raw());
+	}
+}
+
+void step()
+{
+	switch (current)
+	{
+	case phase_center:
+		if (find("center all axes and then press space\n") >= 0)
+		{
+			center_time = cycles();
+			type(" ");
+			current = phase_range;
+		}
+		break;
+
+	case phase_range:
+		if (range_start == 0)
+		{
+			range_start = find("move all axes across full range and then press space\n");
+			if (range_start < 0)
+			{
+				range_start = 0;
+				break;
+			}
+			range_time = cycles();
+			set_axes(low);
+		}
+		else if (output()[output_len() - 1] == '\n')
+		{
+			uint16_t const n = rows();
+			if (n == rows_per_end)
+				set_axes(high);
+			else if (n == 2 * rows_per_end)
+			{
+				type(" ");
+				current = phase_done;
+			}
+		}
+		break;
+
+	case phase_done:
+		if (find("\tdone.\n", range_start) >= 0)
+		{
+			// 16 outputs of the filters at 2.08ms each
+			TEST_CHECK(range_time - center_time >= 16 * 2 * (F_CPU / 1000));
+			TEST_CHECK(range_time - center_time < F_CPU / 10);
+			TEST_CHECK(find("Calibration canceled") < 0);
+			check_calibration();
+			finish();
+		}
+		break;
+	}
+}
+
+int main()
+{
+	set_axes(512);
+	type("C");
+	return run("calibration", &step, 10);
+}
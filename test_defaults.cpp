@@ -0,0 +1,133 @@
+// A fresh EEPROM: the default configuration has to center every axis,
+// the reversed ones included, and take each to both ends of its range.
+
+#include "test_harness.hpp"
+
+using namespace harness;
+
+static const uint8_t first_frames = 10;
+
+// Long enough for the filters to settle and the heartbeat to send a frame
+static const cycle_t phase_cycles = F_CPU / 2;
+
+// The sampled response curve falls short of the ends by a little of the
+// interpolation in its last segment.
+static const int16_t end_tolerance = 32767 / 1000;
+
+struct frame
+{
+	int16_t axes[input_axes];
+};
+
+// Up to max binary frames of the output after the offset from
+uint8_t parse(size_t from, frame * res, uint8_t max)
+{
+	uint8_t n = 0;
+	size_t const size = 2 + binary_frame_size;
+	for (size_t i = from; n != max && i + size <= output_len(); ++i)
+	{
+		uint8_t const * p = (uint8_t const *)output() + i;
+		if (p[0] != 0x80 || p[1] != (0x10 | binary_frame_size))
+			continue;
+		for (uint8_t j = 0; j != input_axes; ++j)
+			res[n].axes[j] = int16_t(p[2 + 2 * j] | (p[3 + 2 * j] << 8));
+		++n;
+		i += size - 1;
+	}
+	return n;
+}
+
+// The last complete frame after the offset from
+bool latest_frame(size_t from, frame & res)
+{
+	static frame all[256];
+	uint8_t const n = parse(from, all, 255);
+	if (n == 0)
+		return false;
+	res = all[n - 1];
+	return true;
+}
+
+void set_axes(uint16_t v)
+{
+	for (uint8_t i = 0; i != input_axes; ++i)
+		avrlib::host::adc_input(adcs[i].channel(), v);
+}
+
+enum phase { phase_center, phase_low, phase_high };
+
+phase current = phase_center;
+size_t phase_start = 0;
+cycle_t phase_time = 0;
+
+void next_phase(phase p, uint16_t v)
+{
+	set_axes(v);
+	current = p;
+	phase_start = output_len();
+	phase_time = cycles();
+}
+
+// The end each axis is taken to by the input v, 0 or 1023
+int16_t expected(uint8_t axis, uint16_t v)
+{
+	return (v == 0) != adcs[axis].reverse()? -32767: 32767;
+}
+
+void check_end(uint16_t v)
+{
+	frame f;
+	if (!TEST_CHECK(latest_frame(phase_start, f)))
+		return;
+	for (uint8_t i = 0; i != input_axes; ++i)
+	{
+		int16_t const e = expected(i, v);
+		if (!TEST_CHECK(e < 0? f.axes[i] <= e + end_tolerance: f.axes[i] >= e - end_tolerance))
+			fprintf(stderr, "  axis %u at input %u: %d\n", i, v, f.axes[i]);
+	}
+}
+
+void step()
+{
+	switch (current)
+	{
+	case phase_center:
+	{
+		frame first[first_frames];
+		if (parse(0, first, first_frames) != first_frames)
+			break;
+		for (uint8_t i = 0; i != first_frames; ++i)
+		{
+			for (uint8_t j = 0; j != input_axes; ++j)
+			{
+				if (!TEST_CHECK(first[i].axes[j] == 0))
+					fprintf(stderr, "  frame %u, axis %u: %d\n", i, j, first[i].axes[j]);
+			}
+		}
+		next_phase(phase_low, 0);
+		break;
+	}
+
+	case phase_low:
+		if (cycles() - phase_time < phase_cycles)
+			break;
+		check_end(0);
+		next_phase(phase_high, 1023);
+		break;
+
+	case phase_high:
+		if (cycles() - phase_time < phase_cycles)
+			break;
+		check_end(1023);
+		finish();
+		break;
+	}
+}
+
+int main()
+{
+	// the axes centered and the EEPROM of the model erased
+	set_axes(512);
+	type("2");
+	return run("defaults", &step, 10);
+}
@@ -0,0 +1,125 @@
+#ifndef TEST_HARNESS_HPP
+#define TEST_HARNESS_HPP
+
+// The transmitter in a host test, see the test_*.cpp next to it.
+//
+// The firmware is included with its main() renamed and runs unmodified
+// on the register model. The console on USART1 is attached to the test,
+// which feeds it its input and inspects its output as it is sent. The
+// firmware never returns, so the test ends the process from the callbacks
+// with finish(); a test that takes longer than its deadline of simulated
+// time fails, and one that hangs is killed after a minute of CPU time.
+
+#define main transmitter_main
+#include "yunibeer_transmitter.cpp"
+#undef main
+
+#include <sys/resource.h>
+
+#include "avrlib/host/test.hpp"
+
+namespace harness {
+
+using avrlib::host::cycle_t;
+using avrlib::host::cycles;
+
+static const size_t output_size = 1 << 20;
+
+struct state
+{
+	char const * name;
+	void (*step)();
+	cycle_t deadline;
+
+	char output[output_size];
+	size_t output_len;
+
+	char const * input;
+};
+
+inline state & test()
+{
+	static state s;
+	return s;
+}
+
+// Ends the process with the verdict of the test.
+inline void finish()
+{
+	avrlib::host::shutdown();
+	_Exit(avrlib::host::test_result(test().name));
+}
+
+inline void fail(char const * reason)
+{
+	fprintf(stderr, "%s: %s after %.3fs\n", test().name, reason, double(cycles()) / F_CPU);
+	TEST_CHECK(false);
+	finish();
+}
+
+// Queues the characters for the console; the previous input must have
+// been taken.
+inline void type(char const * s)
+{
+	test().input = s;
+}
+
+inline size_t output_len()
+{
+	return test().output_len;
+}
+
+inline char const * output()
+{
+	return test().output;
+}
+
+// The offset of the text in the output from the offset from, or -1
+inline long find(char const * text, size_t from = 0)
+{
+	state const & s = test();
+	if (from > s.output_len)
+		return -1;
+	void const * p = memmem(s.output + from, s.output_len - from, text, strlen(text));
+	return p == 0? -1: (char const *)p - s.output;
+}
+
+inline int console_rx()
+{
+	state & s = test();
+	s.step();
+	if (cycles() > s.deadline)
+		fail("timed out");
+	if (s.input == 0 || *s.input == 0)
+		return -1;
+	return uint8_t(*s.input++);
+}
+
+inline void console_tx(uint8_t v)
+{
+	state & s = test();
+	if (s.output_len == output_size)
+		fail("too much output");
+	s.output[s.output_len++] = v;
+	s.step();
+	if (cycles() > s.deadline)
+		fail("timed out");
+}
+
+// Runs the firmware; step() is called after every byte of the output and
+// whenever the idle console is polled for input, about once a frame time.
+inline int run(char const * name, void (*step)(), double seconds)
+{
+	state & s = test();
+	s.name = name;
+	s.step = step;
+	s.deadline = cycle_t(seconds * F_CPU);
+	struct rlimit const cpu = { 60, 60 };
+	setrlimit(RLIMIT_CPU, &cpu);
+	avrlib::host::usart_attach(1, &console_rx, &console_tx);
+	return transmitter_main();
+}
+
+}
+
+#endif
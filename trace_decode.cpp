@@ -0,0 +1,148 @@
+// Decodes the binary trace dumps of the 'J' command into timelines, see
+// send_trace() in avrlib/trace.hpp for the format. The dumps are looked up
+// in the console output, so a whole capture may be passed in:
+//
+//   make trace_decode
+//   build/host/trace_decode capture.bin
+//
+// Every dump is printed as its events with their time since the start and
+// since the previous event, in ms.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define PROGMEM
+#include "trace_events.hpp"
+
+static const uint8_t trace_dump_version = 1;
+static const size_t header_size = 19;
+static const size_t record_size = 5;
+
+struct record
+{
+	uint16_t dt;
+	uint8_t id;
+	uint16_t arg;
+	uint64_t time;
+};
+
+static uint16_t get16(uint8_t const * p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(uint8_t const * p)
+{
+	return get16(p) | (uint32_t(get16(p + 2)) << 16);
+}
+
+static uint64_t delta(record const & r)
+{
+	return r.id == trace_ev_gap? r.dt | (uint64_t(r.arg) << 16): r.dt;
+}
+
+// Prints the dump at p, returns its size or 0 if it is incomplete.
+static size_t decode(uint8_t const * p, size_t size, unsigned dump_no)
+{
+	if (size < header_size)
+		return 0;
+
+	uint8_t const count = p[4];
+	uint16_t const lost = get16(p + 5);
+	uint32_t const last = get32(p + 7);
+	uint32_t const now = get32(p + 11);
+	uint32_t const tick_ns = get32(p + 15);
+	if (size < header_size + count * record_size)
+		return 0;
+
+	std::vector<record> records(count);
+	for (uint8_t i = 0; i != count; ++i)
+	{
+		uint8_t const * q = p + header_size + i * record_size;
+		records[i].dt = get16(q);
+		records[i].id = q[2];
+		records[i].arg = get16(q + 3);
+	}
+
+	// the times are counted back from the newest record
+	uint64_t t = last;
+	for (size_t i = count; i != 0; --i)
+	{
+		records[i - 1].time = t;
+		uint64_t const d = delta(records[i - 1]);
+		t = t >= d? t - d: 0;
+	}
+
+	double const ms = tick_ns / 1e6;
+	printf("dump %u: %u events, %u lost, at %.3f ms\n", dump_no, count, lost, uint32_t(now) * ms);
+	uint64_t prev = count != 0? records[0].time: 0;
+	for (uint8_t i = 0; i != count; ++i)
+	{
+		record const & r = records[i];
+		if (r.id == trace_ev_gap)
+			continue;
+
+		printf("%12.3f %+10.3f  ", r.time * ms, (r.time - prev) * ms);
+		if (r.id < trace_ev_count)
+			printf("%-12s", trace_event_names[r.id]);
+		else
+			printf("event %-6u", r.id);
+
+		if (r.id == trace_ev_command && r.arg >= 0x20 && r.arg < 0x7f)
+			printf(" '%c'\n", r.arg);
+		else
+			printf(" %u (0x%04x)\n", r.arg, r.arg);
+		prev = r.time;
+	}
+	return header_size + count * record_size;
+}
+
+int main(int argc, char * argv[])
+{
+	FILE * f = stdin;
+	if (argc > 1)
+	{
+		f = fopen(argv[1], "rb");
+		if (!f)
+		{
+			perror(argv[1]);
+			return 1;
+		}
+	}
+
+	std::vector<uint8_t> data;
+	uint8_t buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof buf, f)) != 0)
+		data.insert(data.end(), buf, buf + n);
+
+	unsigned dumps = 0;
+	size_t i = 0;
+	while (i + 4 <= data.size())
+	{
+		uint8_t const * p = &data[i];
+		if (p[0] != 'T' || p[1] != 'R' || p[2] != 'C' || p[3] != trace_dump_version)
+		{
+			++i;
+			continue;
+		}
+
+		size_t const size = decode(p, data.size() - i, dumps + 1);
+		if (size == 0)
+		{
+			fprintf(stderr, "incomplete dump at offset %u\n", unsigned(i));
+			break;
+		}
+		++dumps;
+		i += size;
+	}
+
+	if (dumps == 0)
+	{
+		fprintf(stderr, "no dump found\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef TRACE_EVENTS_HPP
+#define TRACE_EVENTS_HPP
+
+// Events of the trace ring, see avrlib/trace.hpp. The names are shared
+// with trace_decode.cpp, which defines PROGMEM away before the include.
+enum trace_event_t
+{
+	trace_ev_gap,         // avrlib::trace_gap, arg: upper bits of the delta
+	trace_ev_boot,        // arg: MCUCSR, the reset cause
+	trace_ev_connect,     // arg: target number | protocol << 8
+	trace_ev_disconnect,
+	trace_ev_no_target,   // arg: target number
+	trace_ev_send_late,   // arg: ticks since the previous frame
+	trace_ev_rx_overflow, // arg: overflow count
+	trace_ev_parse_error, // arg: the rejected byte
+	trace_ev_battery_low, // arg: battery average
+	trace_ev_command,     // arg: the command
+	trace_ev_count
+};
+
+static char const trace_event_names[trace_ev_count][12] PROGMEM = {
+	"gap", "boot", "connect", "disconnect", "no_target",
+	"send_late", "rx_overflow", "parse_error", "battery_low", "command"
+};
+
+#endif
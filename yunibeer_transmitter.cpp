@@ -1,6 +1,15 @@
 #define HW_VERSION 2 // 1 = YUNIBEER, 2 = JAREK
+#define LATENCY_STATS 1 // 0 = off, 1 = stick-to-wire latency of the frames
+#define PROFILER 0 // 0 = off, 1 = cycle counts of the main loop sections
+#define EVENT_TRACE 1 // 0 = off, 1 = ring of the latest events, dumped by 'j' and 'J'
 
 #include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+
+// Pending EEPROM writes are completed before the reset to the bootloader.
+void flush_eeprom();
+#define BOOTSEQ_BEFORE_RESET() flush_eeprom()
 
 #include "avrlib/async_usart.hpp"
 #include "avrlib/usart0.hpp"
@@ -9,9 +18,27 @@
 #include "avrlib/format.hpp"
 #include "avrlib/command_parser.hpp"
 #include "avrlib/eeprom.hpp"
+#include "avrlib/eeprom_log.hpp"
+#include "avrlib/config_block.hpp"
 #include "avrlib/stopwatch.hpp"
+#include "avrlib/timer0.hpp"
+#include "avrlib/timer1.hpp"
+#include "avrlib/monotonic_clock.hpp"
+#include "avrlib/scheduler.hpp"
+#include "avrlib/histogram.hpp"
+#include "avrlib/profiler.hpp"
+#include "avrlib/ram_usage.hpp"
+#include "avrlib/trace.hpp"
+#include "avrlib/pattern_player.hpp"
 #include "avrlib/make_byte.hpp"
+#include "avrlib/channel_map.hpp"
 #include "avrlib/adc.hpp"
+#include "avrlib/adc_scanner.hpp"
+#include "avrlib/seqlock.hpp"
+#include "avrlib/filter.hpp"
+#include "avrlib/response_curve.hpp"
+#include "avrlib/debouncer.hpp"
+#include "avrlib/pgm_table.hpp"
 #include "avrlib/math.hpp" 
 
 #include "avrlib/pin.hpp"
@@ -23,11 +50,15 @@
 #include "avrlib/portf.hpp"
 #include "avrlib/portg.hpp"
 
+#include "address_book.hpp"
 #include "version_info.hpp"
+#include "trace_events.hpp"
 
 #include <string.h>
 using namespace avrlib;
 
+AVRLIB_PAINT_STACK()
+
 struct led_base
 {
 	virtual void clear() {}
@@ -44,64 +75,277 @@ struct led_base
 	#error "Unknown HW_VERSION"
 #endif
 
+// The raw addresses and the calibration of the older firmware, migrated
+// into the address book and the configuration block
 static const uint16_t addr_eeprom_offset = 1;
 static const uint16_t calib_eeprom_offset = 512;
+static const uint16_t config_eeprom_offset = 640;
+static const uint16_t book_eeprom_offset = 1024;
+static const uint16_t log_eeprom_offset = 2560;
+
+// All EEPROM accesses go through the queue, so that saving does not block
+// the main loop; nothing is written during a calibration or an address
+// entry, so the capacity covers either of them at once.
+eeprom_writer<64> eeprom;
+
+void flush_eeprom()
+{
+	eeprom.flush_nointr();
+}
+
+// One record per target number, i.e. eight targets for each protocol
+typedef address_book<eeprom_writer<64> > address_book_t;
+address_book_t book(eeprom, book_eeprom_offset);
+
+// Settings that change often are appended to a wear-leveled log over
+// the rest of the EEPROM rather than rewritten in place.
+enum log_key_t
+{
+	log_key_target,
+	log_key_send_rate,
+	log_key_count
+};
+
+typedef eeprom_log<eeprom_writer<64>, log_key_count,
+	(E2END + 1 - log_eeprom_offset) / sizeof(eeprom_log_record)> settings_log_t;
+settings_log_t settings_log(eeprom, log_eeprom_offset);
+
+static_assert(book_eeprom_offset + address_book_t::eeprom_size <= log_eeprom_offset, "the address book overlaps the log");
+static_assert(log_eeprom_offset + settings_log_t::eeprom_size <= E2END + 1, "the log does not fit into the EEPROM");
+
+typedef monotonic_clock<timer0, timer_fosc_1024> systimer_t;
+systimer_t timer;
+
+// All channels are converted back to back from ADC_vect; with the /128
+// prescaler a conversion takes 104us, a scan of five channels 520us.
+typedef adc_scanner<systimer_t, async_adc, adc_channels> adc_scanner_t;
+adc_scanner_t adc_scan(timer, adcs);
+
+// The trims follow the sticks in the scan and are handled like them, only
+// without a default dead zone; the counts come from analog_inputs.
+static const uint8_t input_axes = analog_inputs::axes + analog_inputs::trims;
+static const uint8_t battery_channel = analog_inputs::first_battery;
+
+static_assert(analog_inputs::batteries == 1, "the battery monitor needs a battery channel");
+static_assert(input_axes <= 10, "the LEGO protocol names the axes by a single digit");
 
-uint8_t current_adc = 0;
+// Gains scale the deviation from the offset to the full range of +-32767.
+typedef fixedpoint<uint16_t, 8> adc_gain_t;
 
-int16_t adc_offset[adc_channels] = { 0, 0, 0, 0, 0 };
-int16_t adc_gain_pos[adc_channels] = { 1, 1, 1, 1, 1 };
-int16_t adc_gain_neg[adc_channels] = { 1, 1, 1, 1, 1 };
+// Shape of the axis response in percent of the full scale: dead-zone around
+// the center, expo (0 linear, 100 cubic) and the limit of the end points.
+struct axis_shape
+{
+	uint8_t deadzone;
+	uint8_t expo;
+	uint8_t limit;
+};
+
+// The calibration and the axis shapes are read from the RAM copy only;
+// changes are written to the EEPROM by task_config a while later.
+struct config_t
+{
+	int16_t adc_offset[input_axes];
+	adc_gain_t adc_gain_neg[input_axes];
+	adc_gain_t adc_gain_pos[input_axes];
+	axis_shape axis_shapes[input_axes];
+};
+
+static const uint8_t config_version = 1;
+
+typedef config_block<eeprom_writer<64>, config_t, config_version> config_block_t;
+config_block_t config(eeprom, config_eeprom_offset);
+
+static_assert(config_eeprom_offset + config_block_t::eeprom_size <= book_eeprom_offset, "the configuration overlaps the address book");
 
-int16_t get_pot(int index, const bool& raw = false)
+// The gain mapping the extent to the full scale, see avrlib::full_scale_gain
+adc_gain_t full_scale_gain(int16_t extent)
 {
-	if(raw)
-		return adcs[index].value();
-	int32_t v = int16_t(adcs[index].value() - adc_offset[index]);
-	v *= *((v < 0 ? adc_gain_neg : adc_gain_pos) + index);
-	return clamp(v, -32767, 32767);
+	return avrlib::full_scale_gain<adc_gain_t::value_type, 8>(extent);
 }
 
-struct timer_t
+// Centered 10-bit axes over their whole range; the reversed inputs read
+// negated, from -1023 to 0.
+void default_config(config_t & c)
 {
-	typedef uint32_t time_type;
+	for (uint8_t i = 0; i != input_axes; ++i)
+	{
+		bool const reversed = adcs[i].reverse();
+		c.adc_offset[i] = reversed? -512: 512;
+		c.adc_gain_neg[i] = full_scale_gain(reversed? 511: 512);
+		c.adc_gain_pos[i] = full_scale_gain(reversed? 512: 511);
+		c.axis_shapes[i].deadzone = i < analog_inputs::axes? 2: 0;
+		c.axis_shapes[i].expo = 0;
+		c.axis_shapes[i].limit = 100;
+	}
+}
+
+// The calibration of the older firmware: the offsets, the negative and the
+// positive gains of all axes and the format, which is cleared once the
+// calibration is taken over. Older firmware yet stored integer gains.
+static const uint8_t calib_format_q8_8 = 0x88;
+static const uint8_t calib_format_migrated = 0x00;
+static const uint16_t calib_size = 2 * input_axes;
+static const uint16_t calib_format_eeprom_offset = calib_eeprom_offset + 3 * calib_size;
+
+// The configuration is written before the old calibration is marked, so
+// that a power loss in between repeats the migration.
+bool import_legacy_calibration()
+{
+	uint8_t format;
+	if (eeprom.load(calib_format_eeprom_offset, format) == calib_format_migrated)
+		return false;
+
+	config_t c = config.get();
+	eeprom.load(calib_eeprom_offset, (uint8_t*)c.adc_offset, calib_size);
+	eeprom.load(calib_eeprom_offset + calib_size, (uint8_t*)c.adc_gain_neg, calib_size);
+	eeprom.load(calib_eeprom_offset + 2 * calib_size, (uint8_t*)c.adc_gain_pos, calib_size);
+
+	// never calibrated
+	if (format == 0xff && c.adc_offset[0] == -1)
+		return false;
 
-	timer_t()
-		: m_overflows(0)
+	if (format != calib_format_q8_8)
 	{
-		TCCR0 = (1<<CS02)|(1<<CS01)|(1<<CS00);
-		TIMSK |= (1<<TOIE0);
+		// integer gains, at most 255 fit into 8.8 bits
+		for (uint8_t i = 0; i != input_axes; ++i)
+		{
+			int16_t neg = c.adc_gain_neg[i].get_raw();
+			int16_t pos = c.adc_gain_pos[i].get_raw();
+			c.adc_gain_neg[i] = adc_gain_t(clamp(neg, 1, 255));
+			c.adc_gain_pos[i] = adc_gain_t(clamp(pos, 1, 255));
+		}
 	}
 
-	void process()
+	config.replace(c);
+	config.flush();
+	eeprom.write(calib_format_eeprom_offset, calib_format_migrated);
+	return true;
+}
+
+// Sampled with each published snapshot, i.e. every 2.08ms, so a switch
+// settles after about 8ms.
+debouncer switches;
+
+uint8_t get_buttons()
+{
+	return switches.state();
+}
+
+// Each axis is averaged over 4 scans and then smoothed with alpha = 1/4,
+// giving one output per 2.08ms with a time constant of about 8ms; use
+// median3_filter instead to remove spikes only. The axes are right-adjusted
+// 10-bit values, negated when reversed, so they do not wrap as int16_t.
+typedef oversampled_filter<4, iir_filter<int16_t, 2> > axis_filter_t;
+axis_filter_t axis_filters[input_axes];
+
+// Calibrated and shaped value of the axis for the filtered input x.
+struct axis_response
+{
+	uint8_t index;
+
+	int16_t operator()(int32_t x) const
 	{
-		++m_overflows;
+		int16_t const d = clamp(x - config->adc_offset[index], -32767, 32767);
+		int32_t v = mul_sat(d, d < 0? config->adc_gain_neg[index]: config->adc_gain_pos[index]);
+
+		axis_shape const & sh = config->axis_shapes[index];
+		int32_t const dz = 32767L * sh.deadzone / 100;
+		int32_t a = v < 0? -v: v;
+		a = a <= dz? 0: (a - dz) * 32767 / (32767 - dz);
+		a = (a * (100 - sh.expo) + (((a * a) >> 15) * a >> 15) * sh.expo) / 100;
+		a = a * sh.limit / 100;
+		return v < 0? -a: a;
 	}
+};
+
+// The response is sampled over the calibrated range of each axis, beyond
+// which it saturates, with the dead zone kept exact.
+typedef response_curve<8> axis_curve_t;
+axis_curve_t axis_curves[input_axes];
 
-	time_type operator()() const
+// Must be called whenever the configuration changes.
+void build_axis_curves()
+{
+	config_t const & c = config.get();
+	for (uint8_t i = 0; i != input_axes; ++i)
 	{
-		uint8_t tcnt = TCNT0;
-		for (;;)
-		{
-			uint16_t overflows = m_overflows;
-			uint8_t tcnt2 = TCNT0;
-			if (tcnt < tcnt2)
-				return (time_type(overflows) << 8) + tcnt2;
-			tcnt = tcnt2;
-		}
+		int32_t const gain_neg = c.adc_gain_neg[i].get_raw() != 0? c.adc_gain_neg[i].get_raw(): 1;
+		int32_t const gain_pos = c.adc_gain_pos[i].get_raw() != 0? c.adc_gain_pos[i].get_raw(): 1;
+		int32_t const span_neg = ((int32_t(32767) << 8) + gain_neg - 1) / gain_neg;
+		int32_t const span_pos = ((int32_t(32767) << 8) + gain_pos - 1) / gain_pos;
+		int32_t const lo = c.adc_offset[i] - span_neg;
+		int32_t const hi = c.adc_offset[i] + span_pos;
+		int32_t const dead_lo = c.adc_offset[i] - span_neg * c.axis_shapes[i].deadzone / 100;
+		int32_t const dead_hi = c.adc_offset[i] + span_pos * c.axis_shapes[i].deadzone / 100;
+
+		axis_response f = { i };
+		axis_curve_t curve;
+		curve.build(clamp(lo, -32768, 32767), clamp(dead_lo, -32768, 32767),
+			clamp(dead_hi, -32768, 32767), clamp(hi, -32768, 32767), f);
+
+		cli();
+		axis_curves[i] = curve;
+		sei();
 	}
-	
-	inline time_type value() const { return this->operator()(); }
+}
+
+// Inputs as of the end of one ADC scan; all fields of a frame come from it.
+// The raw values of the axes are filtered but not calibrated.
+struct input_snapshot
+{
+	int16_t axes[input_axes];
+	uint16_t raw[adc_channels];
+	uint8_t buttons;
+	uint16_t battery;
+	systimer_t::time_type time;
+	uint16_t scan;
+};
 
-	uint16_t volatile m_overflows;
-} timer;
+seqlock<input_snapshot> inputs;
 
+// Called from ADC_vect when a scan is complete; publishes whenever the
+// axis filters produce new values.
+void publish_inputs()
+{
+	bool ready = false;
+	for (uint8_t i = 0; i != input_axes; ++i)
+		ready = axis_filters[i].add(adc_scan[i].value);
+	if (!ready)
+		return;
+
+	input_snapshot & in = inputs.back();
+	for (uint8_t i = 0; i != adc_channels; ++i)
+		in.raw[i] = adc_scan[i].value;
+	for (uint8_t i = 0; i != input_axes; ++i)
+	{
+		in.raw[i] = axis_filters[i].value();
+		in.axes[i] = axis_curves[i](in.raw[i]);
+	}
+	switches.sample(read_switches());
+	in.buttons = switches.state();
+	in.battery = in.raw[battery_channel];
+	in.time = adc_scan[adc_channels - 1].time;
+	in.scan = adc_scan[adc_channels - 1].scan;
+	inputs.publish();
+}
 
+
+// Buzzer driven by Timer3 in CTC mode toggling OC3A; the argument is the
+// OCR3A value selecting the tone, 0 for the default one.
 struct repro_t
 {
-	void set()
+	typedef uint16_t arg_type;
+
+	template <uint16_t hz>
+	struct tone
+	{
+		static const uint16_t value = F_CPU / (2UL * hz) - 1;
+	};
+
+	void set(arg_type tone = 0)
 	{
-		OCR3A = 0x4000;
+		OCR3A = tone == 0? 0x4000: tone;
 		TCCR3A = (1<<COM3A0);
 		TCCR3B = (1<<WGM32)|(1<<CS30);
 		DDRE |= (1<<3);
@@ -115,89 +359,346 @@ struct repro_t
 	}
 };
 
-template <typename Timer, typename Output>
-class signaller_t
+led_base * const leds[8] = { &led0, &led1, &led2, &led3, &led4, &led5, &led6, &led7 };
+
+// The LED bank as a pattern player output; the low byte of the argument
+// selects the LEDs, the high byte lights the selected ones red instead of
+// green.
+struct led_bank_t
 {
-public:
-	typedef typename Timer::time_type time_type;
+	typedef uint16_t arg_type;
 
-	signaller_t(Timer const & timer, Output & out)
-		: m_timer(timer), m_out(out), m_base(0), m_count(0), m_active(true)
+	led_bank_t()
+		: m_mask(0)
 	{
 	}
 
-	void signal(int count, time_type length = 4000, time_type space = 3000)
+	void set(arg_type arg)
 	{
-		m_count = count;
-		m_length = length;
-		m_space = space;
-
-		m_base = m_timer();
-
-		m_active = true;
-		m_out.set();
+		m_mask = arg;
+		for (uint8_t i = 0; i != 8; ++i)
+		{
+			if ((m_mask & (1<<i)) == 0)
+				continue;
+			if (arg & (0x100<<i))
+				leds[i]->red();
+			else
+				leds[i]->green();
+		}
 	}
 
-	void process()
+	void clear()
 	{
-		if (m_count == 0)
-			return;
-
-		time_type time = m_timer();
-		if (!m_active && time - m_base > m_space)
+		for (uint8_t i = 0; i != 8; ++i)
 		{
-			m_out.set();
-			m_active = true;
-			m_base = time;
-		}
-		else if (m_active && time - m_base > m_length)
-		{
-			m_out.clear();
-			m_active = false;
-			m_base = time;
-			--m_count;
+			if (m_mask & (1<<i))
+				leds[i]->clear();
 		}
 	}
 
 private:
-	Timer const & m_timer;
-	Output & m_out;
+	uint8_t m_mask;
+};
+
+async_usart<usart1, 128, 128, bootseq> rs232(115200UL, true);
+
+#if LATENCY_STATS
+// Stick-to-wire latency: each frame is tagged with the time of the ADC scan
+// it was built from and with the tx_count() at which its last byte reaches
+// UDR1, where USART1_UDRE_vect takes the latency. Frames queued while three
+// others are in flight go untagged.
+static const uint8_t latency_markers = 4;
+static const uint8_t latency_protocols = 4;
+
+struct latency_marker
+{
+	systimer_t::time_type time;
+	uint16_t end;
+	uint8_t protocol;
+};
+
+latency_marker latency_queue[latency_markers];
+volatile uint8_t latency_head = 0;
+volatile uint8_t latency_tail = 0;
+
+// In ticks, for the protocols 1 to 4
+typedef log2_histogram<systimer_t::time_type, 12> latency_histogram_t;
+latency_histogram_t frame_latency[latency_protocols];
+
+// Called once the frame is queued.
+void tag_frame(systimer_t::time_type sample_time, uint8_t protocol)
+{
+	if (protocol == 0 || protocol > latency_protocols)
+		return;
+
+	cli();
+	uint8_t const head = latency_head;
+	uint8_t const next = (head + 1) % latency_markers;
+	if (next != latency_tail)
+	{
+		latency_queue[head].time = sample_time;
+		latency_queue[head].end = rs232.tx_count() + rs232.tx_buffer().size();
+		latency_queue[head].protocol = protocol;
+		latency_head = next;
+	}
+	sei();
+}
+
+// Called from USART1_UDRE_vect after each byte.
+void record_frame_latency()
+{
+	uint8_t tail = latency_tail;
+	while (tail != latency_head)
+	{
+		latency_marker const & m = latency_queue[tail];
+		if (int16_t(rs232.tx_count() - m.end) < 0)
+			break;
+		frame_latency[m.protocol - 1].add(timer.value_nointr() - m.time);
+		tail = (tail + 1) % latency_markers;
+	}
+	latency_tail = tail;
+}
+#endif
 
-	time_type m_base;
-	int m_count;
-	time_type m_length;
-	time_type m_space;
+#if PROFILER
+// Timer2 counts eighths of the clock off the prescaler it shares with
+// Timer1, which counts 1024ths. Started along with a prescaler reset, the
+// low 7 bits of Timer2 extend Timer1 into a count of 8 cycles that wraps
+// every 4.2s.
+struct profiler_clock
+{
+	static const uint32_t mask = (1UL << 23) - 1;
+	static const uint8_t cycles = 8;
+
+	static void start()
+	{
+		TCCR2 = 0;
+		TCNT2 = 0;
+		SFIOR |= (1<<PSR321);
+		TCCR2 = (1<<CS21);
+	}
+
+	// Usable from the handlers as well
+	static uint32_t value()
+	{
+		uint8_t const sreg = SREG;
+		cli();
+		uint16_t hi = timer1::value();
+		uint8_t const lo = TCNT2 & 0x7f;
+		uint16_t const hi2 = timer1::value();
+		SREG = sreg;
+
+		// Timer1 stepped in between, lo tells on which side
+		if (hi != hi2 && lo < 0x40)
+			hi = hi2;
+		return (uint32_t(hi) << 7) | lo;
+	}
+};
 
-	bool m_active;
+enum profile_section_t
+{
+	prof_connection,
+	prof_send,
+	prof_battery,
+	prof_config,
+	prof_console,
+	prof_adc,
+	prof_idle,
+	prof_count
+};
+
+char const * const profile_section_names[prof_count] = {
+	"connection", "send", "battery", "config", "console", "adc", "idle"
 };
 
-async_usart<usart1, 128, 128, bootseq> rs232(115200UL, false);
+// The sections interrupted by a handler include its time.
+typedef section_profiler<profiler_clock, prof_count> profiler_t;
+profiler_t profiler;
+
+#define PROFILE(section) profile_scope<profiler_t> const profile_scope_(profiler, section)
+#else
+#define PROFILE(section)
+#endif
+
+#if EVENT_TRACE
+// About two seconds of the events at the highest rate, one per frame.
+typedef trace_ring<systimer_t, 32> trace_t;
+trace_t trace(timer);
+
+#define TRACE(event, arg) trace.add(event, arg)
+#define TRACE_NOINTR(event, arg) trace.add_nointr(event, arg)
+#else
+#define TRACE(event, arg) do {} while (0)
+#define TRACE_NOINTR(event, arg) do {} while (0)
+#endif
+
+// Timer1 runs free with the same prescaler as the system timer, so the
+// pattern players take durations in systimer_t ticks.
+typedef pattern_player<timer1, timer1::ocra, repro_t> buzzer_t;
+typedef pattern_player<timer1, timer1::ocrb, led_bank_t> led_player_t;
 
 repro_t repro;
-signaller_t<timer_t, repro_t> signaller(timer, repro);
+buzzer_t buzzer(repro);
+
+led_bank_t led_bank;
+led_player_t led_player(led_bank);
+
+buzzer_t::step const connect_melody[] = {
+	{ systimer_t::ms<64>::value, systimer_t::ms<16>::value, 1, repro_t::tone<1000>::value },
+	{ systimer_t::ms<96>::value, 0,                         1, repro_t::tone<2000>::value }
+};
+
+buzzer_t::step const disconnect_melody[] = {
+	{ systimer_t::ms<64>::value, systimer_t::ms<16>::value, 1, repro_t::tone<2000>::value },
+	{ systimer_t::ms<96>::value, 0,                         1, repro_t::tone<1000>::value }
+};
+
+// ADC noise reduction: conversions are started by idle() right before the
+// ADC noise reduction sleep, which halts the I/O clock and with it the
+// timers and the USART. The time lost is added back to the clock and the
+// start bit of an incoming byte wakes the CPU up through INT2 on RXD1, so
+// the receiver sees the byte. INT2 would fire on every falling edge of the
+// data bits too, so it masks itself until the byte is received. A
+// conversion that cannot be taken in sleep, because something is being
+// transmitted or played or because the main loop is busy, is started
+// normally.
+bool adc_noise_reduction = false;
+volatile bool rx_active = false;
+uint16_t adc_sleep_cycles = 0;
+
+// 13 ADC clocks with the ADC prescaler at 128
+static const uint16_t adc_conversion_cycles = 13 * 128;
+
+void set_adc_noise_reduction(bool enable)
+{
+	cli();
+	adc_noise_reduction = enable;
+	if (enable)
+	{
+		EICRA = (EICRA & ~((1<<ISC21)|(1<<ISC20))) | (1<<ISC21);
+		EIFR = (1<<INTF2);
+		EIMSK |= (1<<INT2);
+	}
+	else
+	{
+		EIMSK &= ~(1<<INT2);
+	}
+	sei();
+	adc_scan.deferred(enable);
+}
 
-void process()
+// Noise of the raw readings over a number of scans, to compare the modes
+struct adc_noise_t
 {
-	signaller.process();
-	rs232.process_rx();
-	rs232.process_tx();
+	uint16_t ref;
+	int32_t sum;
+	uint32_t sumsq;
+};
+
+adc_noise_t adc_noise[adc_channels];
+volatile uint16_t adc_noise_left = 0;
+uint16_t adc_noise_scans = 0;
+
+void start_adc_noise(uint16_t scans)
+{
+	cli();
+	for (uint8_t i = 0; i != adc_channels; ++i)
+	{
+		adc_noise[i].ref = adc_scan[i].value;
+		adc_noise[i].sum = 0;
+		adc_noise[i].sumsq = 0;
+	}
+	adc_noise_scans = scans;
+	adc_noise_left = scans;
+	sei();
 }
 
-template <typename Timer>
-void wait(Timer const & timer, typename Timer::time_type time)
+// Called from ADC_vect when a scan is complete.
+void measure_adc_noise()
 {
-	typename Timer::time_type base = timer();
-	while (timer() - base < time)
+	if (adc_noise_left == 0)
+		return;
+	for (uint8_t i = 0; i != adc_channels; ++i)
 	{
-		process();
+		int16_t const d = adc_scan[i].value - adc_noise[i].ref;
+		adc_noise[i].sum += d;
+		adc_noise[i].sumsq += int32_t(d) * d;
 	}
+	--adc_noise_left;
 }
 
 ISR(TIMER0_OVF_vect)
 {
-	timer.process();
+	timer.tov_interrupt();
+	// keeps the scan going while the main loop is busy
+	adc_scan.start_deferred();
+}
+
+ISR(INT2_vect)
+{
+	EIMSK &= ~(1<<INT2);
+	rx_active = true;
+}
+
+// Only wakes the CPU up from idle() at the next deadline.
+EMPTY_INTERRUPT(TIMER0_COMP_vect);
+
+ISR(TIMER1_COMPA_vect)
+{
+	buzzer.intr();
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+	led_player.intr();
+}
+
+ISR(USART1_RX_vect)
+{
+	rs232.intr_rx();
+	rx_active = false;
+	// armed for the start bit of the next byte
+	if (adc_noise_reduction)
+	{
+		EIFR = (1<<INTF2);
+		EIMSK |= (1<<INT2);
+	}
+#if EVENT_TRACE
+	static uint32_t traced_overflow = 0;
+	if (rs232.overflow() != traced_overflow)
+	{
+		traced_overflow = rs232.overflow();
+		TRACE_NOINTR(trace_ev_rx_overflow, traced_overflow);
+	}
+#endif
+}
+
+ISR(USART1_UDRE_vect)
+{
+	rs232.intr_tx();
+#if LATENCY_STATS
+	record_frame_latency();
+#endif
+}
+
+ISR(EE_READY_vect)
+{
+	eeprom.intr();
 }
 
+ISR(ADC_vect)
+{
+	PROFILE(prof_adc);
+	if (adc_scan.intr())
+	{
+		measure_adc_noise();
+		publish_inputs();
+	}
+}
+
+// guard time around the "///" escape sequence of the bluetooth module
+static const systimer_t::time_type bt_escape_guard_time = systimer_t::ms<1088>::value;
+
 uint8_t from_hex_digit(uint8_t digit)
 {
 	if(digit >= '0' && digit <= '9')
@@ -211,19 +712,17 @@ uint8_t from_hex_digit(uint8_t digit)
 
 bool get_bt_addr(uint8_t addr[6])
 {
-	stopwatch<timer_t> st(timer);
-	while (st() < 17000)
+	stopwatch<systimer_t> st(timer);
+	while (st() < bt_escape_guard_time)
 	{
-		process();
 		led7.toggle();
 	}
 
 	send(rs232, "///");
 	
 	st.clear();
-	while (st() < 17000)
+	while (st() < bt_escape_guard_time)
 	{
-		process();
 		led7.toggle();
 	}
 
@@ -253,18 +752,16 @@ bool get_bt_addr(uint8_t addr[6])
 
 bool connect(uint8_t addr[6])
 {
-	stopwatch<timer_t> st(timer);
-	while (st() < 17000)
+	stopwatch<systimer_t> st(timer);
+	while (st() < bt_escape_guard_time)
 	{
-		process();
 	}
 
 	send(rs232, "///");
 	
 	st.clear();
-	while (st() < 17000)
+	while (st() < bt_escape_guard_time)
 	{
-		process();
 	}
 
 	send(rs232, "AT*ADNRP=1,0\r");
@@ -286,18 +783,16 @@ bool connect(uint8_t addr[6])
 
 bool disconnect()
 {
-	stopwatch<timer_t> st(timer);
-	while (st() < 17000)
+	stopwatch<systimer_t> st(timer);
+	while (st() < bt_escape_guard_time)
 	{
-		process();
 	}
 
 	send(rs232, "///");
 	
 	st.clear();
-	while (st() < 17000)
+	while (st() < bt_escape_guard_time)
 	{
-		process();
 	}
 
 	send(rs232, "AT*ADNRP=0,0\r");
@@ -305,14 +800,9 @@ bool disconnect()
 	return true;
 }
 
-uint8_t get_buttons()
-{
-	return make_byte(sw0.value(), sw1.value(), sw2.value(), sw3.value(), sw4.value(), sw5.value(), sw6.value(), sw7.value());
-}
-
 uint8_t get_target_no(const uint8_t& bank = 0)
 {
-	return (bank << 3) | make_byte(sw6.value(), sw5.value(), sw4.value());
+	return (bank << 3) | digital_inputs::target(get_buttons());
 }
 
 template <typename Stream>
@@ -371,474 +861,1190 @@ void sw_test()
 	send(rs232, sw6.read() ? "1" : "0");
 	send(rs232, sw7.read() ? "1" : "0");
 	send(rs232, "\n");
+	send(rs232, "read_switches:\n");
+	send_bin_text(rs232, read_switches(), 8);
+	send(rs232, "\n");
 	send(rs232, "get_buttons:\n");
 	send_bin_text(rs232, get_buttons(), 8);
 	send(rs232, "\n");
+	send(rs232, "pressed, released:\n");
+	send_bin_text(rs232, switches.take_pressed(), 8);
+	send(rs232, " ");
+	send_bin_text(rs232, switches.take_released(), 8);
+	send(rs232, "\n");
 	send(rs232, "get_target_no:\n");
 	send_int(rs232, get_target_no());
 	send(rs232, "\n\n");
 	rs232.flush();
 }
 
+void print_address(uint8_t slot)
+{
+	format(rs232, "%x2: ") % slot;
+	address_book_t::status_t const status = book.status(slot);
+	if (status == address_book_t::empty)
+	{
+		send(rs232, "empty\r\n");
+		return;
+	}
+
+	uint8_t const * mac = book.mac(slot);
+	for (uint8_t i = 0; i < 6; ++i)
+		send_hex(rs232, mac[i], 2);
+
+	address_book_t::record r;
+	book.load(slot, r);
+	send(rs232, " \"");
+	for (uint8_t i = 0; i != address_book_t::name_length && r.name[i] != 0; ++i)
+		rs232.write(r.name[i]);
+	format(rs232, "\" protocol % , flags %x2% \r\n") % book.protocol(slot) % book.flags(slot) %
+		(status == address_book_t::corrupt? ", corrupt": "");
+}
+
 void led_test()
 {
-	uint32_t wait_time = 16384>>1;
-	led_base* led[8] = { &led0, &led1, &led2, &led3, &led4, &led5, &led6, &led7 };
+	systimer_t::time_type wait_time = systimer_t::us<524288>::value;
 	for(uint8_t i = 0; i != 8; ++i)
 	{
-		led[i]->green();
+		leds[i]->green();
 		format(rs232, "led% .green\n") % i;
 		rs232.flush();
 		wait(timer, wait_time);
-		led[i]->red();
+		leds[i]->red();
 		format(rs232, "led% .red\n") % i;
 		rs232.flush();
 		wait(timer, wait_time);
-		led[i]->clear();
+		leds[i]->clear();
 	}
 }
 
-int main()
+bool test_mode = false;
+int send_state = 0; // 0 -- silent, 1 -- text, 2 -- binary, 3 -- PIC interface, 4 -- LEGO protocol
+bool connected = false;
+bool force_send = false;
+
+// The binary frame is 0x80, command 1 with the size in the low nibble, the
+// axes as little-endian int16 and the buttons. The nibble, and the buffer
+// of the command_parser on the receiving side, take at most 15 bytes, so
+// the frame carries at most 7 axes and trims together.
+static const uint8_t binary_frame_size = 2 * input_axes + 1;
+static_assert(binary_frame_size <= 15, "the binary frame carries at most 7 axes");
+
+// Only the first buttons are sent over LEGO, which runs at a third of the rate
+static const uint8_t lego_buttons = digital_inputs::buttons < 2? digital_inputs::buttons: 2;
+
+uint8_t mac_addr[6];
+int32_t cnt = 0;
+uint8_t addr = 255;
+
+timed_command_parser<systimer_t> cmd_parser(timer, systimer_t::ms<128>::value);
+timeout<systimer_t> low_battery_timeout(timer, systimer_t::ms<19200>::value);
+
+void task_connection();
+void task_send();
+void task_led_timeout();
+void task_battery();
+void task_config();
+void task_book();
+void task_console();
+
+bool console_ready()
 {
-	sei();
+	return !rs232.empty();
+}
 
-	hw_init();
-	
-	ADCSRA = (1<<ADEN)|(1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0);
-	
-	wait(timer, 1562);
+enum task_id_t
+{
+	task_id_connection,
+	task_id_send,
+	task_id_led_timeout,
+	task_id_battery,
+	task_id_config,
+	task_id_book,
+	task_id_console,
+	task_count
+};
 
-	bool test_mode = false;
+typedef scheduler<systimer_t, task_count> scheduler_t;
+
+// Periodic tasks come first, so that they win ties against background ones.
+scheduler_t::task const tasks[task_count] = {
+	{ "connection",  &task_connection,  systimer_t::ms<16>::value,    task_restart, 0 },
+	{ "send",        &task_send,        systimer_t::us<8192>::value,  task_skip,    0 },
+	{ "led_timeout", &task_led_timeout, 0,                            task_restart, 0 },
+	{ "battery",     &task_battery,     systimer_t::ms<100>::value,   task_restart, 0 },
+	{ "config",      &task_config,      systimer_t::ms<1000>::value,  task_restart, 0 },
+	{ "book",        &task_book,        systimer_t::ms<128>::value,   task_restart, 0 },
+	{ "console",     &task_console,     0,                            task_restart, &console_ready }
+};
 
-	int send_state = test_mode ? 0 : (get_target_no() + 1); // 0 -- silent, 1 -- text, 2 -- binary, 3 -- PIC interface, 4 -- LEGO protocol
-	uint32_t data_send_timeout_time = 256; // 16.384ms
-	
-	switch(send_state)
-	{
-	case 1:
-		led0.green();
-		break;
-	case 2:
-		led1.green();
-		break;
-	case 3:
-		led2.green();
-		break;
-	case 4:
-		led3.green();
-		data_send_timeout_time = 256*3; // 16.384ms * 3
-		break;
-	case 5:
-		led4.green();
-		break;
-	case 6:
-		led5.green();
-		break;
-	case 7:
-		led6.green();
-		break;
-	case 8:
-		led7.green();
-		break;
-	}
-	
-	load_eeprom(calib_eeprom_offset +  0, (uint8_t*)adc_offset,   8);
-	load_eeprom(calib_eeprom_offset +  8, (uint8_t*)adc_gain_neg, 8);
-	load_eeprom(calib_eeprom_offset + 16, (uint8_t*)adc_gain_pos, 8);
+scheduler_t sched(timer, tasks);
 
-	bool connected = false;
-	bool force_send = false;
+// Actual intervals between the runs of the send task, in ticks around
+// the send period
+histogram<systimer_t::time_type, 16> send_intervals;
+systimer_t::time_type last_send_time = 0;
+bool last_send_valid = false;
 
-	timed_command_parser<timer_t> cmd_parser(timer, 2000);
-	timeout<timer_t> led_timeout(timer, 7000);
-	led_timeout.cancel();
+// The send task runs at the maximum rate, but a frame is only sent when
+// a button changed or an axis moved by more than send_threshold since
+// the last frame, and then for send_hold more so that the final position
+// gets through. Idle inputs are sent every send_heartbeat, which is at
+// most send_max_gap so that the watchdogs of the robots stay fed; a zero
+// heartbeat sends every frame.
+static const systimer_t::time_type send_max_gap = systimer_t::ms<500>::value;
 
-	timeout<timer_t> low_battery_timeout(timer, 300000);
-	timeout<timer_t> data_send_timeout(timer, data_send_timeout_time);
+uint16_t send_threshold = 256;
+systimer_t::time_type send_heartbeat = systimer_t::ms<100>::value;
+systimer_t::time_type send_hold = systimer_t::ms<64>::value;
 
-	signaller.signal(1, 1500);
-	
-	wait(timer, 8192, process);
-	led0.clear();
-	led1.clear();
-	led2.clear();
-	led3.clear();
+input_snapshot last_frame;
+systimer_t::time_type last_frame_time = 0;
+systimer_t::time_type last_change_time = 0;
+bool last_frame_valid = false;
+
+uint32_t frames_sent = 0;
+uint32_t frames_suppressed = 0;
+
+// The send settings packed as by the binary command 11: the threshold in
+// 64ths of the axis units, the heartbeat and the hold in 4ms.
+static const uint32_t default_send_rate = 4 | (25UL << 8) | (16UL << 16);
 
-	uint8_t mac_addr[6];
+void set_send_rate(uint32_t packed)
+{
+	send_threshold = uint8_t(packed) * 64;
+	send_heartbeat = systimer_t::ms<4>::value * uint8_t(packed >> 8);
+	if (send_heartbeat > send_max_gap)
+		send_heartbeat = send_max_gap;
+	send_hold = systimer_t::ms<4>::value * uint8_t(packed >> 16);
+}
+
+bool frame_due(input_snapshot const & in, systimer_t::time_type now)
+{
+	if (!last_frame_valid)
+		return true;
 
-	int32_t cnt = 0;
+	bool changed = in.buttons != last_frame.buttons;
+	for (uint8_t i = 0; !changed && i != input_axes; ++i)
+	{
+		int16_t const d = in.axes[i] - last_frame.axes[i];
+		changed = uint16_t(d < 0? -d: d) > send_threshold;
+	}
+	if (changed)
+		last_change_time = now;
 
-	uint8_t addr = 255;
+	return changed || now - last_change_time < send_hold || now - last_frame_time >= send_heartbeat;
+}
 
-	for (;;)
+void set_send_period(systimer_t::time_type period)
+{
+	sched.period(task_id_send, period);
+	send_intervals.range(period - send_intervals.bins / 2, 1);
+}
+
+// Time spent in idle(), for the duty-cycle statistics
+systimer_t::time_type idle_stats_base = 0;
+systimer_t::time_type idle_ticks = 0;
+uint32_t idle_count = 0;
+
+void clear_idle_stats()
+{
+	idle_stats_base = timer();
+	idle_ticks = 0;
+	idle_count = 0;
+}
+
+void task_connection()
+{
+	PROFILE(prof_connection);
+	uint8_t const sw = get_buttons();
+
+	if (!test_mode && !connected && digital_inputs::connect(sw))
 	{
-		if (!test_mode && !connected && sw7.read())
+		addr = get_target_no(send_state - 1);
+		if (book.status(addr) == address_book_t::valid)
 		{
-			addr = get_target_no(send_state - 1); 
-			load_eeprom(addr_eeprom_offset + 6 * addr, mac_addr, 6);
+			memcpy(mac_addr, book.mac(addr), 6);
 			connect(mac_addr);
-			connected = true;
-			cnt = 0;
+			TRACE(trace_ev_connect, addr | (send_state << 8));
+			buzzer.play(connect_melody, 2);
+			settings_log.set(log_key_target, addr);
 		}
-
-		if (!test_mode && connected && !sw7.read())
+		else
 		{
-			disconnect();
-			connected = false;
+			// nothing to connect to
+			TRACE(trace_ev_no_target, addr);
+			buzzer.play(systimer_t::ms<96>::value, systimer_t::ms<64>::value, 3);
 		}
+		connected = true;
+		cnt = 0;
+	}
 
-		if (!rs232.empty())
-		{
-			uint8_t ch = rs232.read();
-			switch (cmd_parser.push_data(ch))
-			{
-			case 'n':
-				rs232.write('\n');
-				break;
-				
-			case '0':
-				send(rs232, "silent\n");
-				send_state = 0;
-				force_send = false;
-				break;
-				
-			case '1':
-				send(rs232, "text\n");
-				send_state = 1;
-				force_send = true;
-				break;
-				
-			case '2':
-				send(rs232, "bin\n");
-				send_state = 2;
-				PORTC ^= (1<<5)|(1<<7);
-				force_send = true;
-				break;
-				
-			case '3':
-				send(rs232, "PIC\n");
-				send_state = 3;
-				force_send = true;
-				break;
-				
-			case '4':
-				send(rs232, "LEGO\n");
-				send_state = 4;
-				force_send = true;
-				break;
-				
-			case '5':
-			case '6':
-			case '7':
-			case '8':
-				send(rs232, "This protocol was not implemented yet.\n");
-				send_state = 0;
-				force_send = false;
-				break;
-				
-			case '?':
-				force_send = false;
-				format(rs232, "Yunibeer transmitter\n\t% \n\t% \n\t\tselected: % \n") % build_info %
-					"'1' -- text, '2' -- binary, 3 -- PIC interface, 4 -- LEGO protocol\r\n" %
-					send_state;
-				break;
-				
-			case 'g':
-				format(rs232, "protocol % , address %  ") % send_state % get_target_no(send_state - 1);
-				load_eeprom(addr_eeprom_offset + 6 * get_target_no(send_state - 1), mac_addr, 6);
-				for (uint8_t i = 0; i < 6; ++i)
-					send_hex(rs232, mac_addr[i], 2);
-				send(rs232, "\r\n");
-				break;
-				
-			case 'r':
-				signaller.signal(3, 4000, 3000);
-				break;
-				
-			case 'R':
-				repro.clear();
-				break;
-				
-			case 'p':
-				for (uint8_t j = 0; j != 64; ++j)
-				{
-					if((j % 8) == 0)
-						format(rs232, "\nProtocol % \n") % (j / 8);
-					else if((j % 4) == 0)
-						send(rs232, "\r\n");
-					format(rs232, "%x2: ") % j;
-					load_eeprom(addr_eeprom_offset + 6 * j, mac_addr, 6);
-					for (uint8_t i = 0; i < 6; ++i)
-						send_hex(rs232, mac_addr[i], 2);
-					send(rs232, "\r\n");
-				}
-				break;
-				
-			case 'P':
+	if (!test_mode && connected && !digital_inputs::connect(sw))
+	{
+		disconnect();
+		TRACE(trace_ev_disconnect, 0);
+		connected = false;
+		buzzer.play(disconnect_melody, 2);
+	}
+}
+
+void task_send()
+{
+	PROFILE(prof_send);
+	if (!connected && !force_send)
+	{
+		last_send_valid = false;
+		last_frame_valid = false;
+		return;
+	}
+
+	systimer_t::time_type now = timer();
+	if (last_send_valid)
+	{
+		systimer_t::time_type const interval = now - last_send_time;
+		send_intervals.add(interval);
+		if (interval > 2 * sched.period(task_id_send))
+			TRACE(trace_ev_send_late, interval > 0xffff? 0xffff: interval);
+	}
+	last_send_time = now;
+	last_send_valid = true;
+
+	input_snapshot in;
+	inputs.read(in);
+
+	if (!frame_due(in, now))
+	{
+		++frames_suppressed;
+		return;
+	}
+	++frames_sent;
+	last_frame = in;
+	last_frame_time = now;
+	last_frame_valid = true;
+
+	switch(send_state)
+	{
+	case 1:
+		for (uint8_t i = 0; i != input_axes; ++i)
+			send_int(rs232, in.axes[i], 7);
+		send(rs232, "  ");
+		send_hex(rs232, in.buttons, 2);
+		send(rs232, "\r\n");
+		break;
+	case 2:
+		// command 1, the size in the low nibble
+		rs232.write(0x80);
+		rs232.write(0x10 | binary_frame_size);
+		for (uint8_t i = 0; i != input_axes; ++i)
+			send_bin(rs232, in.axes[i]);
+		send_bin(rs232, in.buttons);
+		break;
+	case 3:
+		rs232.write(0xFF);
+		for (uint8_t i = 0; i != input_axes; ++i)
+			send_bin(rs232, avrlib::clamp(uint8_t(128+(in.axes[i]>>8)), 0, 254));
+		break;
+	case 4:
+	{
+		char title[3] = "a0";
+		for (uint8_t i = 0; i != input_axes; ++i, ++title[1])
+			send_lego(rs232, title, float(in.axes[i])/32767.f);
+		title[0] = 'b';
+		title[1] = '0';
+		for (uint8_t i = 0; i != lego_buttons; ++i, ++title[1])
+			send_lego(rs232, title, (in.buttons & (1<<i)) != 0);
+		//send_lego(rs232, "cnt", float(cnt));
+		++cnt;
+	}
+	break;
+	}
+
+#if LATENCY_STATS
+	tag_frame(in.time, send_state);
+#endif
+}
+
+void task_led_timeout()
+{
+	led4.clear();
+	led5.clear();
+	led6.clear();
+	led7.clear();
+
+	if (connected)
+	{
+		buzzer.stop();
+		buzzer.play(systimer_t::ms<256>::value, systimer_t::ms<192>::value, 5);
+	}
+
+	sched.suspend(task_id_led_timeout);
+}
+
+// The battery reading is averaged with a time constant of 3.2s. It is low
+// below low_battery_threshold until it rises 1.5% above it. The remaining
+// runtime is extrapolated from the drop of the state of charge since
+// a reference point, which moves on after every 10%.
+static const uint16_t low_battery_hysteresis = low_battery_threshold / 64;
+static const uint16_t battery_runtime_unknown = 0xffff;
+
+iir_filter<uint16_t, 5> battery_average;
+bool battery_low = false;
+uint16_t battery_soc = 0;
+uint16_t battery_runtime = battery_runtime_unknown;
+
+uint16_t battery_ref_soc = 0;
+systimer_t::time_type battery_ref_time = 0;
+
+void update_battery_runtime(systimer_t::time_type now)
+{
+	if (battery_runtime == battery_runtime_unknown && battery_ref_soc == 0)
+	{
+		battery_ref_soc = battery_soc;
+		battery_ref_time = now;
+		return;
+	}
+
+	// charging or a fresh battery
+	if (battery_soc > battery_ref_soc)
+	{
+		battery_ref_soc = battery_soc;
+		battery_ref_time = now;
+		battery_runtime = battery_runtime_unknown;
+		return;
+	}
+
+	uint16_t const drop = battery_ref_soc - battery_soc;
+	if (drop < 20)
+		return;
+
+	uint32_t const elapsed = (now - battery_ref_time) / systimer_t::ms<1000>::value;
+	uint32_t const runtime = elapsed * battery_soc / drop / 60;
+	battery_runtime = runtime < battery_runtime_unknown? runtime: battery_runtime_unknown - 1;
+
+	if (drop >= 100)
+	{
+		battery_ref_soc = battery_soc;
+		battery_ref_time = now;
+	}
+}
+
+// Gathers the configuration changes of a second, e.g. a series of axis
+// shape commands, into a single EEPROM update.
+void task_config()
+{
+	PROFILE(prof_config);
+	config.flush();
+}
+
+// Converts the address book of the older firmware a record at a time,
+// about 11s of EEPROM writes after the first power-up.
+void task_book()
+{
+	if (!book.migrate_step())
+		sched.suspend(task_id_book);
+}
+
+void task_battery()
+{
+	PROFILE(prof_battery);
+	uint16_t const avg = battery_average(inputs.read().battery);
+	if (avg < low_battery_threshold)
+	{
+		if (!battery_low)
+			TRACE(trace_ev_battery_low, avg);
+		battery_low = true;
+	}
+	else if (avg > low_battery_threshold + low_battery_hysteresis)
+		battery_low = false;
+
+	battery_soc = pgm_interpolate(battery_soc_table,
+		sizeof battery_soc_table / sizeof battery_soc_table[0], avg);
+	update_battery_runtime(timer());
+
+	if (battery_low && low_battery_timeout)
+	{
+		buzzer.play(systimer_t::ms<96>::value, systimer_t::ms<64>::value, 3);
+		led_player.play(systimer_t::ms<96>::value, systimer_t::ms<64>::value, 3, 0xffff);
+		low_battery_timeout.restart();
+	}
+}
+
+// Prints the name and the size of a static object; the names stay in the
+// flash, so that the report does not take the RAM it reports.
+uint16_t ram_budget(char const * name, uint16_t size)
+{
+	send_spgm(rs232, name);
+	format(rs232, "\t% \n") % size;
+	return size;
+}
+
+#define RAM_BUDGET(object) ram_budget(PSTR(#object), sizeof object)
+
+void print_ram_budget()
+{
+	uint16_t total = 0;
+	total += RAM_BUDGET(rs232);
+	total += RAM_BUDGET(eeprom);
+	total += RAM_BUDGET(book);
+	total += RAM_BUDGET(settings_log);
+	total += RAM_BUDGET(config);
+	total += RAM_BUDGET(adc_scan);
+	total += RAM_BUDGET(axis_filters);
+	total += RAM_BUDGET(axis_curves);
+	total += RAM_BUDGET(inputs);
+	total += RAM_BUDGET(last_frame);
+	total += RAM_BUDGET(adc_noise);
+	total += RAM_BUDGET(sched);
+	total += RAM_BUDGET(tasks);
+	total += RAM_BUDGET(cmd_parser);
+	total += RAM_BUDGET(send_intervals);
+	total += RAM_BUDGET(buzzer);
+	total += RAM_BUDGET(led_player);
+#if LATENCY_STATS
+	total += RAM_BUDGET(latency_queue);
+	total += RAM_BUDGET(frame_latency);
+#endif
+#if PROFILER
+	total += RAM_BUDGET(profiler);
+#endif
+#if EVENT_TRACE
+	total += RAM_BUDGET(trace);
+#endif
+	format(rs232, "listed\t% \nstatic\t% \n") % total % static_ram();
+}
+
+#if EVENT_TRACE
+// The events oldest first, with their time since the start in ms; the
+// times are counted back from the newest record.
+void print_trace()
+{
+	trace.pause(true);
+	systimer_t::time_type t = trace.last();
+	for (uint8_t i = trace.size(); i > 1; --i)
+	{
+		trace_record const & r = trace[i - 1];
+		t -= r.dt;
+		if (r.id == trace_gap)
+			t -= systimer_t::time_type(r.arg) << 16;
+	}
+
+	format(rs232, "events % , lost % \n") % trace.size() % trace.lost();
+	for (uint8_t i = 0; i != trace.size(); ++i)
+	{
+		trace_record const & r = trace[i];
+		if (i != 0)
+		{
+			t += r.dt;
+			if (r.id == trace_gap)
+				t += systimer_t::time_type(r.arg) << 16;
+		}
+		if (r.id == trace_gap)
+			continue;
+
+		format(rs232, "% \t") % systimer_t::to_ms(t);
+		if (r.id < trace_ev_count)
+			send_spgm(rs232, trace_event_names[r.id]);
+		else
+			send_int(rs232, r.id);
+		format(rs232, "\t% \n") % r.arg;
+	}
+	trace.pause(false);
+}
+#endif
+
+void task_console()
+{
+	PROFILE(prof_console);
+	if (rs232.empty())
+		return;
+
+	uint8_t ch = rs232.read();
+	uint8_t const cmd = cmd_parser.push_data(ch);
+	if (cmd == 254)
+		TRACE(trace_ev_parse_error, ch);
+	else if (cmd != 255)
+		TRACE(trace_ev_command, cmd);
+
+	switch (cmd)
+	{
+	case 'n':
+		rs232.write('\n');
+		break;
+		
+	case '0':
+		send(rs232, "silent\n");
+		send_state = 0;
+		force_send = false;
+		break;
+		
+	case '1':
+		send(rs232, "text\n");
+		send_state = 1;
+		force_send = true;
+		break;
+		
+	case '2':
+		send(rs232, "bin\n");
+		send_state = 2;
+		PORTC ^= (1<<5)|(1<<7);
+		force_send = true;
+		break;
+		
+	case '3':
+		send(rs232, "PIC\n");
+		send_state = 3;
+		force_send = true;
+		break;
+		
+	case '4':
+		send(rs232, "LEGO\n");
+		send_state = 4;
+		force_send = true;
+		break;
+		
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+		send(rs232, "This protocol was not implemented yet.\n");
+		send_state = 0;
+		force_send = false;
+		break;
+		
+	case '?':
+		force_send = false;
+		format(rs232, "Yunibeer transmitter\n\t% \n\t% \n\t\tselected: % \n") % build_info %
+			"'1' -- text, '2' -- binary, 3 -- PIC interface, 4 -- LEGO protocol\r\n" %
+			send_state;
+		break;
+		
+	case 'g':
+		format(rs232, "protocol % , address ") % send_state;
+		print_address(get_target_no(send_state - 1));
+		break;
+		
+	case 'r':
+		buzzer.play(systimer_t::ms<256>::value, systimer_t::ms<192>::value, 3);
+		break;
+		
+	case 'R':
+		buzzer.stop();
+		break;
+		
+	case 'p':
+		for (uint8_t j = 0; j != 64; ++j)
+		{
+			if((j % 8) == 0)
+				format(rs232, "\nProtocol % \n") % (j / 8);
+			else if((j % 4) == 0)
+				send(rs232, "\r\n");
+			print_address(j);
+		}
+		break;
+		
+	case 'P':
+	{
+		send(rs232, "insert address index (00 - 3F): ");
+		rs232.flush();
+		for (uint8_t i = 0; i < 6; ++i)
+			mac_addr[i] = 0;
+		uint8_t addr = from_hex_digit(rs232.read())<<4;
+		addr |= from_hex_digit(rs232.read());
+		if(addr > 63)
+		{
+			send(rs232, "invalid position\n");
+			rs232.flush();
+			break;
+		}
+		format(rs232, "%x2 \ninsert address: ") % addr;
+		rs232.flush();
+		for(uint8_t i = 0; i != 12; ++i)
+		{
+			char ch = rs232.read();
+			uint8_t digit = from_hex_digit(ch);
+			if(digit != 255)
+				mac_addr[i>>1] |= digit;
+			else
 			{
-				send(rs232, "insert address index (00 - 3F): ");
+				send(rs232, " invalid character\n");
 				rs232.flush();
-				for (uint8_t i = 0; i < 6; ++i)
-					mac_addr[i] = 0;
-				uint8_t addr = from_hex_digit(rs232.read())<<4;
-				addr |= from_hex_digit(rs232.read());
-				if(addr > 63)
-				{
-					send(rs232, "invalid position\n");
-					rs232.flush();
-					break;
-				}
-				format(rs232, "%x2 \ninsert address: ") % addr;
-				rs232.flush();
-				for(uint8_t i = 0; i != 12; ++i)
-				{
-					char ch = rs232.read();
-					uint8_t digit = from_hex_digit(ch);
-					if(digit != 255)
-						mac_addr[i>>1] |= digit;
-					else
-					{
-						send(rs232, " invalid character\n");
-						rs232.flush();
-						addr = 255;
-						break;
-					}
-					if((i & 1) == 0)
-						mac_addr[i>>1] <<= 4;
-					rs232.write(ch);
-					rs232.flush();
-				}
-				if(addr != 255)
-					store_eeprom(addr_eeprom_offset + 6 * addr, mac_addr, 6);
-				send(rs232, "\ndone\n\n");
+				addr = 255;
+				break;
+			}
+			if((i & 1) == 0)
+				mac_addr[i>>1] <<= 4;
+			rs232.write(ch);
+			rs232.flush();
+		}
+		if(addr != 255)
+		{
+			send(rs232, "\ninsert name: ");
+			rs232.flush();
+			char name[address_book_t::name_length + 1];
+			uint8_t len = 0;
+			for(char ch = rs232.read(); ch != '\r' && ch != '\n'; ch = rs232.read())
+			{
+				if(len == address_book_t::name_length)
+					continue;
+				name[len++] = ch;
+				rs232.write(ch);
 				rs232.flush();
 			}
-			break;
+			name[len] = 0;
+			book.store(addr, mac_addr, name, addr / 8 + 1, 0);
+		}
+		send(rs232, "\ndone\n\n");
+		rs232.flush();
+	}
+	break;
 
-			case 'a':
-				if(addr == 255)
-				{
-					send(rs232, "I have not used it yet.\n");
-				}
-				else
-				{
-					format(rs232, "last address: %x2 : ") % addr;
+	case 'a':
+		if(addr == 255)
+		{
+			send(rs232, "I have not used it yet.\n");
+		}
+		else
+		{
+			format(rs232, "last address: %x2 : ") % addr;
 
-					for(uint8_t i = 0; i <= 5; ++i)
-					{
-						format(rs232, "%x2") % mac_addr[i];
-					}
-					rs232.write('\n');
-				}
-				break;
+			for(uint8_t i = 0; i <= 5; ++i)
+			{
+				format(rs232, "%x2") % mac_addr[i];
+			}
+			rs232.write('\n');
+		}
+		break;
 
-			case 't':
-				rs232.write('t');
-				led0.red();
-				break;
+	case 't':
+		rs232.write('t');
+		led0.red();
+		break;
 
-			case 'T':
-				rs232.write('T');
-				led0.green();
-				break;
+	case 'T':
+		rs232.write('T');
+		led0.green();
+		break;
 
-			case 'b':
-				send_int(rs232, adcs[4].value());
-				send(rs232, "\r\n");
-				break;
-				
-			case 's':
-				sw_test();
-				break;
-			
-			case 'l':
-				led_test();
-				break;
-				
-			case 'm':
-				if(test_mode)
-					send(rs232, "end of test mode\n");
-				test_mode = false;
-				break;
-				
-			case 'M':
-				send(rs232, "test mode\n");
-				test_mode = true;
-				break;
-				
-			case 'C':
-				send(rs232, "Calibration mode:\n\tcenter all axes and then press space\n");
-				rs232.flush();
-				if(rs232.read() != ' ')
-				{
-					send(rs232, "Calibration canceled!\n");
-					break;
-				}
-				for(uint8_t i = 0; i != 2;)
-				{
-					if(adcs[current_adc].process())
-					{
-						if(++current_adc == adc_channels)
-						{
-							current_adc = 0;
-							++i;
-						}
-						adcs[current_adc].start();
-					}
-				}
-				for(uint8_t i = 0; i != 4; ++i)
-				{
-					adc_offset[i] = get_pot(i, true);
-					adc_gain_neg[i] =  32767;
-					adc_gain_pos[i] = -32768;
-				}
-				send(rs232, "\tmove all axes across full range and then press space\n");
-				rs232.flush();
-				while(rs232.empty())
-				{
-					if(adcs[current_adc].process())
-					{
-						if(++current_adc == adc_channels)
-						{
-							current_adc = 0;
-							for(uint8_t i = 0; i != 4; ++i)
-							{
-								int16_t v = get_pot(i, true) - adc_offset[i];
-								if(v < adc_gain_neg[i])
-									adc_gain_neg[i] = v;
-								if(v > adc_gain_pos[i])
-									adc_gain_pos[i] = v;
-								format(rs232, "%7 %7 %7 ") % adc_gain_neg[i] % v % adc_gain_pos[i];
-							}
-							send(rs232, "\r\n");
-							rs232.flush();
-						}
-						adcs[current_adc].start();
-					}
-					process();
-				}
-				if(rs232.read() != ' ')
-				{
-					send(rs232, "\tCalibration canceled!\n");
-					break;
-				}
-				for(uint8_t i = 0; i != 4; ++i)
-				{
-					adc_gain_neg[i] = -32767 / adc_gain_neg[i];
-					adc_gain_pos[i] =  32767 / adc_gain_pos[i];
-					format(rs232, "%7 %7 %7 ") % adc_gain_neg[i] % adc_offset[i] % adc_gain_pos[i];
-				}
-				send(rs232, "\r\n");
-				store_eeprom(calib_eeprom_offset +  0, (uint8_t*)adc_offset,   8);
-				store_eeprom(calib_eeprom_offset +  8, (uint8_t*)adc_gain_neg, 8);
-				store_eeprom(calib_eeprom_offset + 16, (uint8_t*)adc_gain_pos, 8);
-				send(rs232, "\tdone.\n");
-				break;
+	case 'b':
+		format(rs232, "battery % , average % , charge % % , runtime % min% \n") %
+			inputs.read().battery % battery_average.value() % ((battery_soc + 5) / 10) % '%' %
+			battery_runtime % (battery_low? ", low": "");
+		break;
+		
+	case 's':
+		sw_test();
+		break;
+	
+	case 'l':
+		led_test();
+		break;
+		
+	case 'm':
+		if(test_mode)
+			send(rs232, "end of test mode\n");
+		test_mode = false;
+		break;
+		
+	case 'M':
+		send(rs232, "test mode\n");
+		test_mode = true;
+		break;
+		
+	case 'k':
+		for (uint8_t i = 0; i != scheduler_t::size; ++i)
+		{
+			scheduler_t::stats const & st = sched.get_stats(i);
+			format(rs232, "% \t% \t% \t% \t% \n") % sched.name(i) % st.runs % st.overruns %
+				systimer_t::to_us(st.max_jitter) % systimer_t::to_us(st.wcet);
+		}
+		break;
 
-			case 8:
-				if (cmd_parser.size() > 0)
-				{
-					if (cmd_parser[0] & (1<<0))
-						led4.red();
-					else
-						led4.green();
-
-					if (cmd_parser[0] & (1<<1))
-						led5.red();
-					else
-						led5.green();
-
-					if (cmd_parser[0] & (1<<2))
-						led6.red();
-					else
-						led6.green();
-
-					if (cmd_parser[0] & (1<<3))
-						led7.red();
-					else
-						led7.green();
-					led_timeout.restart();
-				}
-				break;
+	case 'K':
+		sched.clear_stats();
+		break;
 
-			case 255:
-				break;
+	case 'z':
+		set_adc_noise_reduction(!adc_noise_reduction);
+		format(rs232, "ADC noise reduction % \n") % (adc_noise_reduction? "on": "off");
+		break;
 
-			default:
-				force_send = false;
-			}
+	case 'v':
+		start_adc_noise(256);
+		break;
+
+	case 'V':
+	{
+		// mean and variance in hundredths of a count
+		cli();
+		uint16_t const n = adc_noise_scans - adc_noise_left;
+		sei();
+		format(rs232, "% scans, noise reduction % \n") % n % (adc_noise_reduction? "on": "off");
+		for (uint8_t i = 0; n != 0 && i != adc_channels; ++i)
+		{
+			adc_noise_t const & st = adc_noise[i];
+			int32_t const mean = st.sum / n;
+			uint32_t const var = uint32_t((int64_t(st.sumsq) * n - int64_t(st.sum) * st.sum) * 100 / (int64_t(n) * n));
+			format(rs232, "% \t% \t% \n") % i % uint16_t(st.ref + mean) % var;
+		}
+	}
+	break;
+
+	case 'x':
+		for (uint8_t i = 0; i != input_axes; ++i)
+		{
+			axis_shape const & sh = config->axis_shapes[i];
+			axis_curve_t const & c = axis_curves[i];
+			format(rs232, "axis % : dead-zone % , expo % , limit % , flat % .. % \n") %
+				i % sh.deadzone % sh.expo % sh.limit % c.dead_lo() % c.dead_hi();
+			for (uint8_t j = axis_curve_t::points; j != 0; --j)
+				format(rs232, "% ") % c.lo(j - 1);
+			for (uint8_t j = 0; j != axis_curve_t::points; ++j)
+				format(rs232, "% ") % c.hi(j);
+			send(rs232, "\r\n");
 		}
+		break;
 
-		if (led_timeout)
+	case 'd':
+		for (uint8_t i = 0; i != adc_scanner_t::channels; ++i)
 		{
-			led4.clear();
-			led5.clear();
-			led6.clear();
-			led7.clear();
+			adc_scanner_t::sample s = adc_scan.get(i);
+			format(rs232, "% \t% \t% \t% \n") % i % s.value % s.scan % systimer_t::to_us(s.time);
+		}
+		break;
 
-			if (connected)
-				signaller.signal(5);
+	case 'h':
+		format(rs232, "frames % , min % , max % \n") % send_intervals.count() %
+			systimer_t::to_us(send_intervals.min()) % systimer_t::to_us(send_intervals.max());
+		for (uint8_t i = 0; i != send_intervals.bins; ++i)
+			format(rs232, "% \t% \n") % systimer_t::to_us(send_intervals.bin_base(i)) % send_intervals[i];
+		break;
+
+	case 'H':
+		send_intervals.clear();
+		break;
 
-			led_timeout.cancel();
+#if LATENCY_STATS
+	case 'w':
+		for (uint8_t i = 0; i != latency_protocols; ++i)
+		{
+			cli();
+			latency_histogram_t const h = frame_latency[i];
+			sei();
+			if (h.count() == 0)
+				continue;
+
+			format(rs232, "protocol % , frames % , min % , avg % , max % us\n") % (i + 1) % h.count() %
+				systimer_t::to_us(h.min()) % systimer_t::to_us(h.mean()) % systimer_t::to_us(h.max());
+			for (uint8_t j = 0; j != h.bins; ++j)
+				format(rs232, "% \t% \n") % systimer_t::to_us(h.bin_base(j)) % h[j];
 		}
+		break;
+
+	case 'W':
+		cli();
+		for (uint8_t i = 0; i != latency_protocols; ++i)
+			frame_latency[i].clear();
+		sei();
+		break;
+#endif
+
+	case 'u':
+	{
+		// the stack peak is what the paint has lost
+		uint16_t const stack_ram = stack_size() + ram_free();
+		format(rs232, "static % , stack % , peak % , free % , min free % \n") % static_ram() %
+			stack_size() % (stack_ram - stack_unused()) % ram_free() % stack_unused();
+		break;
+	}
+
+	case 'U':
+		print_ram_budget();
+		break;
 
-		if (data_send_timeout)
+#if EVENT_TRACE
+	case 'j':
+		print_trace();
+		break;
+
+	case 'J':
+		// binary, for trace_decode
+		send_trace(rs232, trace, uint32_t(systimer_t::ticks<1000>::us));
+		break;
+#endif
+
+#if PROFILER
+	case 'q':
+		// the durations in cycles, the totals in us; the console itself
+		// is measured up to here
+		for (uint8_t i = 0; i != prof_count; ++i)
 		{
-			data_send_timeout.restart();
+			cli();
+			profiler_t::stats const st = profiler[i];
+			sei();
+			if (st.count() == 0)
+				continue;
+
+			format(rs232, "% \truns % , total % us, cycles min % , avg % , max % \n") % profile_section_names[i] %
+				st.count() % (st.sum() / (F_CPU / 1000000 / profiler_clock::cycles)) %
+				(st.min() * profiler_clock::cycles) % (st.mean() * profiler_clock::cycles) %
+				(st.max() * profiler_clock::cycles);
+			for (uint8_t j = 0; j != st.bins; ++j)
+			{
+				if (st[j] != 0)
+					format(rs232, "\t% \t% \n") % (st.bin_base(j) * profiler_clock::cycles) % st[j];
+			}
+		}
+		cli();
+		profiler.clear();
+		sei();
+		break;
+#endif
+
+	case 'f':
+		format(rs232, "sent % , suppressed % , threshold % , heartbeat % ms, hold % ms\n") %
+			frames_sent % frames_suppressed % send_threshold %
+			systimer_t::to_ms(send_heartbeat) % systimer_t::to_ms(send_hold);
+		break;
+
+	case 'F':
+		frames_sent = 0;
+		frames_suppressed = 0;
+		break;
+
+	case 'i':
+	{
+		systimer_t::time_type total = timer() - idle_stats_base;
+		format(rs232, "total % us, idle % us in %  sleeps, active % % \n") %
+			systimer_t::to_us(total) % systimer_t::to_us(idle_ticks) % idle_count %
+			(total == 0? 0: uint32_t((uint64_t(total - idle_ticks) * 100) / total)) % '%';
+	}
+	break;
+
+	case 'I':
+		clear_idle_stats();
+		break;
+
+	case 'L':
+		format(rs232, "log head % , tail % , sequence % , writes % \n") % settings_log.head() %
+			settings_log.tail() % settings_log.sequence() % settings_log.writes();
+		for (uint8_t i = 0; i != settings_log_t::keys; ++i)
+		{
+			uint32_t value;
+			if (settings_log.get(i, value))
+				format(rs232, "% \t% \t%x8\n") % i % settings_log.slot(i) % value;
+		}
+		break;
 
-			if(connected || force_send)
+	case 'e':
+		format(rs232, "eeprom pending % , written % , skipped % % \n") % eeprom.pending() %
+			eeprom.written() % eeprom.skipped() % (eeprom.busy()? ", busy": "");
+		eeprom.clear_stats();
+		break;
+
+	case 'c':
+		format(rs232, "config dirty %x8\n") % config.dirty_chunks();
+		break;
+
+	case 'C':
+	{
+		int16_t offset[input_axes];
+		int16_t lo[input_axes];
+		int16_t hi[input_axes];
+		send(rs232, "Calibration mode:\n\tcenter all axes and then press space\n");
+		rs232.flush();
+		if(rs232.read() != ' ')
+		{
+			send(rs232, "Calibration canceled!\n");
+			break;
+		}
+		// let the axis filters settle
+		for(uint8_t seq = inputs.sequence(); uint8_t(inputs.sequence() - seq) < 16;)
+		{
+		}
+		for(uint8_t i = 0; i != input_axes; ++i)
+		{
+			offset[i] = inputs.read().raw[i];
+			lo[i] = 0;
+			hi[i] = 0;
+		}
+		send(rs232, "\tmove all axes across full range and then press space\n");
+		rs232.flush();
+		for(uint8_t seq = inputs.sequence(); rs232.empty();)
+		{
+			if(inputs.sequence() != seq)
 			{
-				switch(send_state)
+				seq = inputs.sequence();
+				input_snapshot in;
+				inputs.read(in);
+				for(uint8_t i = 0; i != input_axes; ++i)
 				{
-				case 1:
-					for (int i = 0; i < 4; ++i)
-						send_int(rs232, get_pot(i), 7);
-					send(rs232, "  ");
-					send_hex(rs232, get_buttons(), 2);
-					send(rs232, "\r\n");
-					break;
-				case 2:
-					rs232.write(0x80);
-					rs232.write(0x19);
-					for (int i = 0; i < 4; ++i)
-						send_bin(rs232, get_pot(i));
-					send_bin(rs232, get_buttons());
-					break;
-				case 3:
-					rs232.write(0xFF);
-					for (int i = 0; i < 4; ++i)
-						send_bin(rs232, avrlib::clamp(uint8_t(128+(get_pot(i)>>8)), 0, 254));
-					break;
-				case 4:
-					send_lego(rs232, "a0", float(get_pot(0))/32767.f);
-					send_lego(rs232, "a1", float(get_pot(1))/32767.f);
-					send_lego(rs232, "a2", float(get_pot(2))/32767.f);
-					send_lego(rs232, "a3", float(get_pot(3))/32767.f);
-					send_lego(rs232, "b0", sw0.read());
-					send_lego(rs232, "b1", sw1.read());
-					//send_lego(rs232, "b2", sw2.read());
-					//send_lego(rs232, "b3", sw3.read());
-					//send_lego(rs232, "cnt", float(cnt));
-					++cnt;
-					break;
+					int16_t v = in.raw[i] - offset[i];
+					if(v < lo[i])
+						lo[i] = v;
+					if(v > hi[i])
+						hi[i] = v;
+					format(rs232, "%7 %7 %7 ") % lo[i] % v % hi[i];
 				}
+				send(rs232, "\r\n");
+				rs232.flush();
 			}
 		}
+		if(rs232.read() != ' ')
+		{
+			send(rs232, "\tCalibration canceled!\n");
+			break;
+		}
+		// gains in 8.8 bits, printed multiplied by 256
+		for(uint8_t i = 0; i != input_axes; ++i)
+		{
+			config.set(&config_t::adc_offset, i, offset[i]);
+			config.set(&config_t::adc_gain_neg, i, full_scale_gain(-lo[i]));
+			config.set(&config_t::adc_gain_pos, i, full_scale_gain(hi[i]));
+			format(rs232, "%7 %7 %7 ") % config->adc_gain_neg[i].get_raw() % config->adc_offset[i] %
+				config->adc_gain_pos[i].get_raw();
+		}
+		send(rs232, "\r\n");
+		build_axis_curves();
+		send(rs232, "\tdone.\n");
+	}
+	break;
 
-		if (adcs[current_adc].process())
+	case 8:
+		if (cmd_parser.size() > 0)
 		{
-			if (++current_adc == adc_channels)
-				current_adc = 0;
+			if (cmd_parser[0] & (1<<0))
+				led4.red();
+			else
+				led4.green();
+
+			if (cmd_parser[0] & (1<<1))
+				led5.red();
+			else
+				led5.green();
+
+			if (cmd_parser[0] & (1<<2))
+				led6.red();
+			else
+				led6.green();
+
+			if (cmd_parser[0] & (1<<3))
+				led7.red();
+			else
+				led7.green();
+			sched.resume(task_id_led_timeout, systimer_t::ms<448>::value);
+		}
+		break;
 
-			adcs[current_adc].start();
+	case 9:
+		// axis, dead-zone, expo, limit
+		if (cmd_parser.size() == 4 && cmd_parser[0] < input_axes)
+		{
+			axis_shape sh;
+			sh.deadzone = clamp(cmd_parser[1], 0, 90);
+			sh.expo = clamp(cmd_parser[2], 0, 100);
+			sh.limit = clamp(cmd_parser[3], 0, 100);
+			config.set(&config_t::axis_shapes, cmd_parser[0], sh);
+			build_axis_curves();
 		}
+		break;
 
-		if (adcs[4].value() < low_battery_threshold && low_battery_timeout)
+	case 10:
+		// battery status: average, charge in permille, runtime in minutes
+		// (0xffff unknown) and the low flag
+		rs232.write(0x80);
+		rs232.write(0xA7);
+		send_bin(rs232, battery_average.value());
+		send_bin(rs232, battery_soc);
+		send_bin(rs232, battery_runtime);
+		send_bin(rs232, uint8_t(battery_low));
+		break;
+
+	case 11:
+		// send threshold, heartbeat and hold, see default_send_rate
+		if (cmd_parser.size() == 3)
 		{
-			signaller.signal(3, 1500, 1000);
-			low_battery_timeout.restart();
+			uint32_t const packed = cmd_parser[0] | (uint32_t(cmd_parser[1]) << 8) |
+				(uint32_t(cmd_parser[2]) << 16);
+			set_send_rate(packed);
+			settings_log.set(log_key_send_rate, packed);
 		}
+		break;
+
+	case 12:
+		// slot of the target with the name, 0xff if there is none
+		cmd_parser.write(book.find((char const *)cmd_parser.data(), cmd_parser.size()));
+		cmd_parser.send(rs232, 12);
+		break;
+
+	case 255:
+		break;
+
+	default:
+		force_send = false;
+	}
+}
+
+// Sleeps until the next deadline or until an interrupt arrives. Timer0
+// compare match is set to the deadline if it comes before the next overflow,
+// RX and ADC interrupts wake the CPU up by themselves.
+void idle()
+{
+	PROFILE(prof_idle);
+	if (adc_noise_reduction)
+	{
+		cli();
+		bool const quiet = !rx_active && rs232.tx_done() && !buzzer.active() && !led_player.active();
+		if (adc_scan.start_deferred() && quiet)
+		{
+			set_sleep_mode(SLEEP_MODE_ADC);
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+			set_sleep_mode(SLEEP_MODE_IDLE);
+
+			// woken up by INT2 during the conversion, assume half of it was lost
+			cli();
+			adc_sleep_cycles += async_adc::running()? adc_conversion_cycles / 2: adc_conversion_cycles;
+			timer.advance(adc_sleep_cycles / systimer_t::prescaler);
+			adc_sleep_cycles %= systimer_t::prescaler;
+			sei();
+			return;
+		}
+		sei();
+	}
+
+	systimer_t::time_type deadline = 0;
+	bool const has_deadline = sched.next_deadline(deadline);
+	systimer_t::time_type start = timer();
+
+	if (has_deadline && !time_after(deadline, start))
+		return;
+
+	cli();
+	if (has_deadline && deadline - start <= timer0::top())
+	{
+		timer0::ocra::value(uint8_t(deadline));
+		timer0::ocra::interrupt(true);
+	}
+
+	if (sched.pending() || (has_deadline && !time_before(timer.value_nointr(), deadline)))
+	{
+		timer0::ocra::interrupt(false);
+		sei();
+		return;
+	}
+
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+
+	timer0::ocra::interrupt(false);
+	idle_ticks += timer() - start;
+	++idle_count;
+}
+
+int main()
+{
+#if EVENT_TRACE
+	TRACE(trace_ev_boot, MCUCSR);
+	MCUCSR = 0;
+#endif
+	sei();
+
+	hw_init();
+	
+	ADCSRA = (1<<ADEN)|(1<<ADIE)|(1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0);
+	adc_scan.start();
+
+	rs232.async_tx(true);
+	timer1::clock_source(timer_fosc_1024);
+#if PROFILER
+	profiler_clock::start();
+#endif
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	
+	wait(timer, systimer_t::ms<100>::value);
+
+	// start from the settled inputs rather than debounce them from zero
+	cli();
+	switches.reset(read_switches());
+	sei();
 
-		process();
+	send_state = test_mode ? 0 : (get_target_no() + 1);
+	systimer_t::time_type data_send_timeout_time = systimer_t::us<8192>::value;
+	
+	switch(send_state)
+	{
+	case 1:
+		led0.green();
+		break;
+	case 2:
+		led1.green();
+		break;
+	case 3:
+		led2.green();
+		break;
+	case 4:
+		led3.green();
+		data_send_timeout_time = systimer_t::us<8192 * 3>::value;
+		break;
+	case 5:
+		led4.green();
+		break;
+	case 6:
+		led5.green();
+		break;
+	case 7:
+		led6.green();
+		break;
+	case 8:
+		led7.green();
+		break;
+	}
+	
+	config_t defaults;
+	default_config(defaults);
+	if (!config.load(defaults))
+		import_legacy_calibration();
+	build_axis_curves();
+	book.init(addr_eeprom_offset);
+	settings_log.init();
+	set_send_rate(settings_log.value(log_key_send_rate, default_send_rate));
+
+	// the last target for 'a'
+	addr = settings_log.value(log_key_target, 255);
+	if (addr < address_book_t::size)
+		memcpy(mac_addr, book.mac(addr), 6);
+	else
+		addr = 255;
+
+	buzzer.play(systimer_t::ms<96>::value, 0);
+	
+	wait(timer, systimer_t::us<524288>::value);
+	led0.clear();
+	led1.clear();
+	led2.clear();
+	led3.clear();
+
+	set_send_period(data_send_timeout_time);
+	sched.suspend(task_id_led_timeout);
+	sched.start();
+	clear_idle_stats();
+
+	for (;;)
+	{
+		if (!sched.run_once())
+		{
+			idle();
+		}
+		else if (adc_noise_reduction)
+		{
+			cli();
+			adc_scan.start_deferred();
+			sei();
+		}
 	}
 }